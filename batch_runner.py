@@ -0,0 +1,300 @@
+# -*- coding: utf-8 -*-
+"""
+batch_runner.py
+
+Runs a manifest of pipeline jobs, one job being (instance, size, mode, seed, solver): a Phase 3 pool of that size
+and mode generated with that seed, then solved with that Phase 4 backend. Jobs from many instances and configurations
+share one pool of worker processes (threads would serialize on the GIL); an idle worker takes the next job that is
+ready, so a slow 500K solve never holds back the small jobs queued behind it.
+
+Read-only instance data is prepared once per instance before its jobs start: the archive is unpacked, the Phase 0
+CSVs are written and the instance is compiled to instance.bin (instance_store.py). Jobs then build their flight
+network on the memory-mapped store, and the generator's own worker processes map the same file, so every job of an
+instance shares the same pages.
+
+Admission is memory-aware. Each job's peak RSS is estimated from its pool size and solver (or, once a job of the same
+instance, size and solver has finished, from the peak that job really reached) and a job is only started while the
+estimates of the running jobs plus its own fit the memory budget (default: 80% of MemAvailable). Large jobs are
+dispatched first and smaller ones fill the remaining budget; a job larger than the whole budget runs alone.
+
+Manifest (JSON):
+
+    {
+      "defaults": {"time_limit": 60, "solver": "highs"},
+      "matrix":   {"instance": [1, 7], "size": ["0K", "50K"], "mode": ["mixed"], "seed": [1, 2, 3]},
+      "jobs":     [{"instance": 7, "size": "500K", "mode": "forced", "seed": 42, "solver": "heuristic"}]
+    }
+
+`matrix` expands to every combination; `jobs` lists single jobs; `defaults` fills missing fields. `instance` is a
+data_instanceN.zip number or an unpacked instance folder, `size` a Phase 3 size name (0K/50K/500K) or a pool size,
+`solver` pulp, highs, heuristic or none (generate only). Results are appended to a JSON-lines file as jobs finish;
+`--resume` skips the jobs that already have a result without an error.
+
+Usage:
+    python batch_runner.py manifest.json [--workers 4] [--memory-mb 16000] [--out batch.jsonl] [--resume]
+"""
+
+import argparse
+import itertools
+import json
+import multiprocessing
+import os
+import resource
+import sys
+import time
+from concurrent.futures import FIRST_COMPLETED, ProcessPoolExecutor, wait
+from pathlib import Path
+
+from benchmark import SIZES, REPO, _measured, stage_generate, stage_parse, stage_solve, unpack
+
+JOB_FIELDS = ("instance", "size", "mode", "seed", "solver")
+DEFAULTS = {"mode": "mixed", "seed": 42, "solver": "highs", "time_limit": 60.0}
+
+# Peak RSS model for a job nobody has measured yet: interpreter, instance and network, plus the pool as the solver
+# holds it (pairing dicts, incidence and the backend's model). Rough on purpose; measured peaks replace it.
+BASE_MB = 100.0
+MB_PER_1K_PAIRINGS = {"pulp": 12.0, "highs": 6.0, "heuristic": 4.0, "none": 0.5}
+
+
+# ============================================================
+#  Manifest
+# ============================================================
+def expand_manifest(manifest):
+    """List of job dicts (JOB_FIELDS + time_limit, plus an `id`) in manifest order."""
+    defaults = dict(DEFAULTS, **manifest.get("defaults", {}))
+    jobs = []
+    matrix = manifest.get("matrix")
+    if matrix:
+        keys = list(matrix)
+        for values in itertools.product(*(matrix[k] for k in keys)):
+            jobs.append(dict(zip(keys, values)))
+    jobs.extend(manifest.get("jobs", []))
+
+    out = []
+    for job in jobs:
+        job = dict(defaults, **job)
+        missing = [k for k in JOB_FIELDS if k not in job]
+        if missing:
+            raise ValueError(f"job {job} is missing {', '.join(missing)}")
+        job["id"] = "/".join(str(job[k]) for k in JOB_FIELDS)
+        out.append(job)
+    return out
+
+
+def size_of(job):
+    """(pool target, generation time limit) of a job; named sizes use the Phase 3 driver configurations."""
+    size = job["size"]
+    for name, target, limit in SIZES:
+        if size == name:
+            return target, job.get("gen_time_limit", limit)
+    target = int(size)
+    return target, job.get("gen_time_limit", max(10.0, target / 2500.0))
+
+
+def estimate_mb(job, measured):
+    """Peak RSS estimate of a job: the measured peak of an equal job when there is one, else the size model."""
+    key = (str(job["instance"]), str(job["size"]), job["solver"])
+    if key in measured:
+        return measured[key]
+    target, _ = size_of(job)
+    return BASE_MB + MB_PER_1K_PAIRINGS.get(job["solver"], 12.0) * max(target, 1000) / 1000.0
+
+
+def available_mb():
+    """MemAvailable from /proc/meminfo in MB, or None where it is not available."""
+    try:
+        with open("/proc/meminfo") as f:
+            for line in f:
+                if line.startswith("MemAvailable:"):
+                    return int(line.split()[1]) / 1024.0
+    except OSError:
+        pass
+    return None
+
+
+# ============================================================
+#  Work (runs in the shared worker processes)
+# ============================================================
+def prepare_instance(spec, workdir):
+    """Unpacks (when `spec` is an archive number), writes the Phase 0 CSVs and compiles the instance, once."""
+    folder = Path(spec) if not str(spec).isdigit() else unpack(int(spec), workdir)
+    name = folder.name if not str(spec).isdigit() else f"instance{spec}"
+    csv_dir = Path(workdir) / f"{name}_work" / "phase0"
+    store = folder / "instance.bin"
+    info = {"folder": str(folder), "csv_dir": str(csv_dir), "store": str(store)}
+    if not store.exists() or not (csv_dir / "pairings.csv").exists():
+        info.update(stage_parse(str(folder), str(csv_dir)))
+    return info
+
+
+def _job(job, prepared, pool_path, workers, keep_pool):
+    target, gen_limit = size_of(job)
+    out = {"generate": stage_generate(prepared["folder"], pool_path, target, gen_limit, job["mode"], job["seed"],
+                                      workers=workers, store=prepared["store"])}
+    if job["solver"] != "none":
+        out["solve"] = stage_solve(prepared["csv_dir"], pool_path, job["solver"], job["time_limit"])
+    if not keep_pool:
+        os.remove(pool_path)
+    return out
+
+
+def run_job(job, prepared, pool_path, workers, keep_pool=False):
+    """
+    One job in a worker process: generation, then the solve, with wall time and peak RSS. `job_rss_mb` bounds the
+    whole job from above (this process plus `workers` generator processes at the largest child peak); admission
+    learns from it.
+    """
+    out = _measured(_job, (job, prepared, pool_path, workers, keep_pool))
+    own = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    child = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss
+    out["job_rss_mb"] = round((own + workers * child) / 1024.0, 1)
+    return out
+
+
+# ============================================================
+#  Scheduler
+# ============================================================
+class BatchRunner:
+    """
+    Dispatches jobs onto one process pool of `workers` slots under a memory budget of `memory_mb`. Each job's own
+    generator gets `gen_workers` processes (default: the cores divided among the slots).
+    """
+
+    def __init__(self, jobs, workdir="batch_work", workers=None, memory_mb=None, gen_workers=None, out=None,
+                 keep_pools=False):
+        self.jobs = jobs
+        self.workdir = Path(workdir)
+        self.workers = max(1, workers or min(len(jobs), os.cpu_count() or 1) or 1)
+        avail = available_mb()
+        self.memory_mb = memory_mb or (0.8 * avail if avail else 8192.0)
+        self.gen_workers = gen_workers or max(1, (os.cpu_count() or 1) // self.workers)
+        self.out = out
+        self.keep_pools = keep_pools
+        self.measured = {}           # (instance, size, solver) -> peak RSS MB of a finished job
+        self.results = []
+
+    def _executor(self):
+        ctx = multiprocessing.get_context("spawn")
+        try:
+            # a fresh process per job: its peak RSS is its own and its memory goes back to the OS when it ends
+            return ProcessPoolExecutor(max_workers=self.workers, mp_context=ctx, max_tasks_per_child=1)
+        except TypeError:            # Python < 3.11
+            return ProcessPoolExecutor(max_workers=self.workers, mp_context=ctx)
+
+    def _record(self, job, result, admitted_mb):
+        rec = {k: job[k] for k in ("id",) + JOB_FIELDS + ("time_limit",)}
+        rec["estimated_mb"] = round(admitted_mb, 1)
+        rec.update(result)
+        self.results.append(rec)
+        peak = result.get("job_rss_mb")
+        if peak:
+            key = (str(job["instance"]), str(job["size"]), job["solver"])
+            self.measured[key] = max(self.measured.get(key, 0.0), peak)
+        if self.out:
+            with open(self.out, "a") as f:
+                f.write(json.dumps(rec) + "\n")
+        solve = result.get("solve", {})
+        print(f"  {job['id']:<40} {result.get('seconds', 0):>8.1f}s {result.get('peak_rss_mb', 0):>8.1f} MB"
+              f"  pool {result.get('generate', {}).get('pool_size')}  objective {solve.get('objective')}"
+              + (f"  ERROR {result['error']}" if "error" in result else ""))
+
+    def run(self):
+        self.workdir.mkdir(parents=True, exist_ok=True)
+        (self.workdir / "pools").mkdir(exist_ok=True)
+        print(f"Batch: {len(self.jobs)} jobs, {self.workers} workers x {self.gen_workers} generator processes, "
+              f"memory budget {self.memory_mb:.0f} MB")
+
+        instances = list(dict.fromkeys(str(j["instance"]) for j in self.jobs))
+        prepared = {}
+        prepping = {}                # future -> instance
+        running = {}                 # future -> (job, estimated MB)
+        pending = sorted(self.jobs, key=lambda j: -estimate_mb(j, self.measured))
+        in_flight = 0.0
+
+        with self._executor() as pool:
+            for spec in instances:
+                prepping[pool.submit(prepare_instance, spec, str(self.workdir))] = spec
+
+            while pending or running or prepping:
+                # admission: largest runnable job first, then smaller ones into what is left of the budget
+                slots = self.workers - len(running) - len(prepping)
+                for job in list(pending):
+                    if slots <= 0:
+                        break
+                    spec = str(job["instance"])
+                    if spec not in prepared:
+                        continue
+                    need = estimate_mb(job, self.measured)
+                    if running and in_flight + need > self.memory_mb:
+                        continue
+                    pending.remove(job)
+                    if "error" in prepared[spec]:
+                        self._record(job, {"error": f"instance preparation failed: {prepared[spec]['error']}"}, 0)
+                        continue
+                    pool_path = str(self.workdir / "pools" / (job["id"].replace("/", "_") + ".pool"))
+                    fut = pool.submit(run_job, job, prepared[spec], pool_path, self.gen_workers, self.keep_pools)
+                    running[fut] = (job, need)
+                    in_flight += need
+                    slots -= 1
+
+                done, _ = wait(list(running) + list(prepping), return_when=FIRST_COMPLETED)
+                for fut in done:
+                    if fut in prepping:
+                        spec = prepping.pop(fut)
+                        try:
+                            prepared[spec] = fut.result()
+                            print(f"Prepared instance {spec}: {prepared[spec]['store']}")
+                        except Exception as e:
+                            prepared[spec] = {"error": f"{type(e).__name__}: {e}"}
+                        continue
+                    job, need = running.pop(fut)
+                    in_flight -= need
+                    try:
+                        result = fut.result()
+                    except Exception as e:  # a failing job is a result too
+                        result = {"error": f"{type(e).__name__}: {e}"}
+                    self._record(job, result, need)
+                # measured peaks may have changed the estimates
+                pending.sort(key=lambda j: -estimate_mb(j, self.measured))
+        return self.results
+
+
+def _finished_ids(path):
+    if not path or not os.path.exists(path):
+        return set()
+    with open(path) as f:
+        return {r["id"] for r in map(json.loads, filter(str.strip, f)) if "error" not in r}
+
+
+def main(argv=None):
+    ap = argparse.ArgumentParser(description="Runs a manifest of (instance, size, mode, seed, solver) jobs.")
+    ap.add_argument("manifest")
+    ap.add_argument("--workers", type=int, default=None, help="concurrent jobs (default: cores)")
+    ap.add_argument("--gen-workers", type=int, default=None, help="generator processes per job")
+    ap.add_argument("--memory-mb", type=float, default=None, help="memory budget (default: 80%% of MemAvailable)")
+    ap.add_argument("--workdir", default="batch_work")
+    ap.add_argument("--out", default="batch.jsonl")
+    ap.add_argument("--resume", action="store_true", help="skip jobs that already have a result in --out")
+    ap.add_argument("--keep-pools", action="store_true")
+    args = ap.parse_args(argv)
+
+    with open(args.manifest) as f:
+        jobs = expand_manifest(json.load(f))
+    if args.resume:
+        done = _finished_ids(args.out)
+        jobs = [j for j in jobs if j["id"] not in done]
+    elif os.path.exists(args.out):
+        os.remove(args.out)
+
+    t0 = time.perf_counter()
+    runner = BatchRunner(jobs, args.workdir, args.workers, args.memory_mb, args.gen_workers, args.out,
+                         args.keep_pools)
+    results = runner.run()
+    failed = sum(1 for r in results if "error" in r)
+    print(f"\n{len(results)} jobs in {time.perf_counter() - t0:.1f}s ({failed} failed) -> {args.out}")
+    return results
+
+
+if __name__ == "__main__":
+    sys.path.insert(0, str(REPO))
+    main()
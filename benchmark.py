@@ -0,0 +1,352 @@
+# -*- coding: utf-8 -*-
+"""
+benchmark.py
+
+End-to-end benchmark over the shipped data_instanceN.zip archives (or synthesized, scaled-up copies of them).
+
+For every instance the archive is unpacked into a work directory and the pipeline stages run one after another, each
+in a fresh worker process so its wall time and peak RSS are measured in isolation:
+
+    parse       Phase 0 CSVs (pairings/legs/incidence) plus the compiled instance store
+    generate    Phase 3 pool at each size configuration (0K / 50K / 500K, as in the Phase 3 driver), legal pairings
+                only, streamed to a .pool file
+    features    Phase 2 batch features over each pool, scored with a compiled cost model when one is given
+    solve       Phase 4 SPP over each pool
+
+Stages talk to each other only through the files they write (CSVs, instance.bin, .pool), which is what makes the
+per-process measurement possible. Every stage records its wall time, peak RSS and whatever sizes it knows about
+(pool size, nonzeros, objective, ...). Results are written as JSON; `--compare` prints the ratios against an earlier
+results file so regressions between builds show up as numbers.
+
+`--scale K` first synthesizes an instance K times larger: K disjoint copies of the leg network (airports, bases,
+legs, pairings and schedules renamed per copy), i.e. K times the legs and pairings with the same structure.
+
+Usage:
+    python benchmark.py [--instances 1,7] [--sizes 0K,50K] [--scale 10] [--backend highs] [--out bench.json]
+    python benchmark.py --compare old.json new.json
+"""
+
+import argparse
+import json
+import multiprocessing
+import os
+import platform
+import re
+import resource
+import subprocess
+import sys
+import time
+import zipfile
+from concurrent.futures import ProcessPoolExecutor
+from pathlib import Path
+
+REPO = Path(__file__).resolve().parent
+SIZES = [("0K", 0, 10), ("50K", 50_000, 30), ("500K", 500_000, 180)]   # Phase 3 driver configurations
+LEG_NAME = re.compile(r"LEG_(\d+)_(\d+)$")
+
+
+# ============================================================
+#  Stages (run in worker processes)
+# ============================================================
+def _measured(fn, args):
+    """Runs one stage and adds its wall time and the peak RSS (MB) of the worker and its own children."""
+    t0 = time.perf_counter()
+    out = fn(*args)
+    out["seconds"] = round(time.perf_counter() - t0, 4)
+    peak_kb = max(resource.getrusage(resource.RUSAGE_SELF).ru_maxrss,
+                  resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss)
+    out["peak_rss_mb"] = round(peak_kb / 1024.0, 1)
+    return out
+
+
+def stage_parse(folder, csv_dir):
+    import phase_0_prep_the_data as p0
+    from instance_store import compile_instance, CompiledInstance
+
+    os.makedirs(csv_dir, exist_ok=True)
+    cwd = os.getcwd()
+    os.chdir(csv_dir)
+    try:
+        p0.main(os.path.join(folder, "initialSolution.in"))
+    finally:
+        os.chdir(cwd)
+    with CompiledInstance(compile_instance(folder)) as inst:
+        return {"legs": len(inst), "pairings": inst.n_pairings, "nnz": len(inst.pair_codes),
+                "schedules": inst.n_schedules}
+
+
+def stage_generate(folder, pool_path, target, time_limit, mode, seed, workers=None, store=None):
+    """Phase 3 pool; with `store` (a compiled instance.bin) the network is built on the mapped store."""
+    from flight_network import FlightNetwork
+    from instance_store import CompiledInstance
+    from phase_3_set_generation_script import parse_solution, generate_sample_parallel
+    from pool_store import PoolWriter
+
+    solution = parse_solution(os.path.join(folder, "initialSolution.in"))
+    legs = CompiledInstance(store) if store else None
+    network = FlightNetwork(legs, legs.bases) if legs else FlightNetwork.from_instance(folder)
+    with PoolWriter(pool_path) as sink:
+        n, elapsed = generate_sample_parallel(solution, target_size=max(target, len(solution)),
+                                              time_limit=time_limit, mode=mode, seed=seed, workers=workers,
+                                              sink=sink, network=network)
+    if legs is not None:
+        legs.close()
+    return {"pool_size": n, "generate_seconds": round(elapsed, 4), "pool_bytes": os.path.getsize(pool_path)}
+
+
+def stage_features(folder, pool_path, cost_model):
+    try:
+        import phase_2_predict_cost_pipeline as p2
+    except ImportError as e:
+        return {"skipped": f"Phase 2 dependencies missing ({e})"}
+    from instance_store import open_instance
+    from pool_store import PoolReader
+
+    rows = 0
+    scorer = p2.CompiledCostModel.load(cost_model) if cost_model else None
+    total = 0.0
+    with open_instance(folder) as inst:
+        table = p2.leg_table_from_compiled(inst)
+        reader = PoolReader(pool_path)
+        for chunk in reader.chunks():
+            pairings = [{"base": reader.bases[chunk.base_ids[k]], "duties": reader.legs.decode(chunk.pairing(k))}
+                        for k in range(len(chunk))]
+            csr = p2.pairings_to_csr(pairings, table, {})
+            p2.pairing_features_batch(csr, table)
+            if scorer is not None:
+                total += float(scorer.score_pairings(pairings, None, {}, leg_table=table).sum())
+            rows += len(pairings)
+    out = {"pool_size": rows}
+    if scorer is not None:
+        out["predicted_cost_total"] = total
+    return out
+
+
+def stage_solve(csv_dir, pool_path, backend, time_limit):
+    from phase_4_set_partitioning_solvers_3 import SPPFromCSV
+
+    solver = SPPFromCSV(csv_dir)
+    solver.load_legs_csv()
+    solver.load_pool(pool_path)
+    selected = solver.solve_spp(backend=backend, time_limit=time_limit) or []
+    return {
+        "rows": solver.m, "pool_size": solver.n, "nnz": solver.a.nnz,
+        "selected": len(selected),
+        "objective": float(sum(solver.c[j] for j in selected)) if selected else None,
+        "feasible": bool(selected) and solver.is_feasible(selected),
+        "lower_bound": solver.lower_bound,
+        "timings": {k: round(v, 4) for k, v in solver.timings.items()},
+    }
+
+
+def run_stage(fn, *args):
+    """One stage in a fresh spawned process, so peak RSS belongs to that stage alone."""
+    ctx = multiprocessing.get_context("spawn")
+    with ProcessPoolExecutor(max_workers=1, mp_context=ctx) as ex:
+        try:
+            return ex.submit(_measured, fn, args).result()
+        except Exception as e:  # a failing stage is a result too
+            return {"error": f"{type(e).__name__}: {e}"}
+
+
+# ============================================================
+#  Instances
+# ============================================================
+def unpack(k, workdir):
+    """Extracts data_instance{k}.zip into workdir; returns the instance folder."""
+    folder = Path(workdir) / f"instance{k}"
+    if not (folder / "initialSolution.in").exists():
+        with zipfile.ZipFile(REPO / f"data_instance{k}.zip") as z:
+            z.extractall(workdir)
+    return folder
+
+
+def _copy_token(token, c, stride):
+    """Leg token renamed for copy c (TDH_/PAL_ markers kept); other activities are left as they are."""
+    prefix = ""
+    bare = token
+    while bare.startswith(("TDH_", "PAL_")):
+        prefix, bare = prefix + bare[:4], bare[4:]
+    m = LEG_NAME.match(bare)
+    if not m or c == 0:
+        return token
+    return f"{prefix}LEG_{m.group(1)}_{int(m.group(2)) + c * stride}"
+
+
+def synthesize_instance(folder, out_folder, factor):
+    """
+    Writes an instance `factor` times larger than `folder` into `out_folder`: day files, listOfBases.csv,
+    initialSolution.in and solution_0 hold `factor` disjoint copies of the original. Copy c renames airports and bases
+    to <name>C<c>, shifts leg numbers by c * stride (leg days are kept) and renumbers pairings and schedules.
+    """
+    folder, out = Path(folder), Path(out_folder)
+    out.mkdir(parents=True, exist_ok=True)
+    day_files = sorted(folder.glob("day_*.csv"))
+
+    top = 0
+    for path in day_files:
+        for line in path.read_text(encoding="utf-8").splitlines()[1:]:
+            m = LEG_NAME.match(line.split(",")[0].strip())
+            if m:
+                top = max(top, int(m.group(2)))
+    stride = 10 ** len(str(top))
+
+    def airport(name, c):
+        return name if c == 0 else f"{name}C{c}"
+
+    for path in day_files:
+        lines = path.read_text(encoding="utf-8").splitlines()
+        rows = [lines[0]]
+        for c in range(factor):
+            for line in lines[1:]:
+                f = [x.strip() for x in line.split(",")]
+                if len(f) < 7:
+                    continue
+                f[0] = _copy_token(f[0], c, stride)
+                f[1], f[4] = airport(f[1], c), airport(f[4], c)
+                rows.append(" , ".join(f))
+        (out / path.name).write_text("\n".join(rows) + "\n", encoding="utf-8")
+
+    lines = (folder / "listOfBases.csv").read_text(encoding="utf-8").splitlines()
+    rows = [lines[0]]
+    for c in range(factor):
+        for line in lines[1:]:
+            f = [x.strip() for x in line.split(",")]
+            if len(f) >= 3:
+                rows.append(" , ".join([airport(f[0], c)] + f[1:]))
+    (out / "listOfBases.csv").write_text("\n".join(rows) + "\n", encoding="utf-8")
+
+    pairing = re.compile(r"Pairing\s+(\d+)\s*:\s*Base\s+(\w+)\s*:\s*([^;]+);")
+    text = (folder / "initialSolution.in").read_text(encoding="utf-8")
+    found = pairing.findall(text)
+    rows = ["Solution = {", ""]
+    for c in range(factor):
+        for pid, base, duties in found:
+            legs = [_copy_token(d.strip(), c, stride) for d in duties.split(",") if d.strip()]
+            rows.append(f"Pairing {int(pid) + c * len(found)} : Base {airport(base, c)} : {' , '.join(legs)};")
+            rows.append("")
+    rows.append("}")
+    (out / "initialSolution.in").write_text("\n".join(rows) + "\n", encoding="utf-8")
+
+    sched_path = folder / "solution_0"
+    if sched_path.exists():
+        from instance_store import SCHEDULE_PATTERN
+        found = SCHEDULE_PATTERN.findall(sched_path.read_text(encoding="utf-8"))
+        rows = ["Solution = {", ""]
+        for c in range(factor):
+            for num, emp, base, acts in found:
+                acts = [_copy_token(a.strip(), c, stride) for a in acts.split("--->") if a.strip()]
+                rows.append(f"schedule {int(num) + c * len(found)} {emp if c == 0 else f'{emp}C{c}'} "
+                            f"({airport(base, c)}) : {'--->'.join(acts)};")
+                rows.append("")
+        rows.append("}")
+        (out / "solution_0").write_text("\n".join(rows) + "\n", encoding="utf-8")
+    return out
+
+
+# ============================================================
+#  Driver
+# ============================================================
+def benchmark_instance(name, folder, workdir, sizes, modes, backend, time_limit, cost_model, seed=42):
+    """All stages for one instance folder; returns the list of result records."""
+    work = Path(workdir) / f"{name}_work"
+    work.mkdir(parents=True, exist_ok=True)
+    csv_dir = str(work / "phase0")
+    records = []
+
+    def record(stage, config, result):
+        rec = {"instance": name, "stage": stage, "config": config}
+        rec.update(result)
+        records.append(rec)
+        shown = {k: v for k, v in result.items() if k in ("seconds", "peak_rss_mb", "pool_size", "nnz", "objective",
+                                                          "error", "skipped")}
+        print(f"  {name:>12} {stage:>9} {config or '':>12}  {shown}")
+
+    record("parse", None, run_stage(stage_parse, str(folder), csv_dir))
+    store = Path(folder) / "instance.bin"                # compiled by the parse stage
+    store = str(store) if store.exists() else None
+    for size, target, limit in sizes:
+        for mode in modes:
+            config = f"{size}/{mode}"
+            pool = str(work / f"{size}_{mode}.pool")
+            record("generate", config, run_stage(stage_generate, str(folder), pool, target, limit, mode, seed,
+                                                 None, store))
+            record("features", config, run_stage(stage_features, str(folder), pool, cost_model))
+            record("solve", config, run_stage(stage_solve, csv_dir, pool, backend, time_limit))
+    return records
+
+
+def _environment():
+    try:
+        commit = subprocess.run(["git", "rev-parse", "--short", "HEAD"], cwd=REPO, capture_output=True,
+                                text=True, check=True).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        commit = None
+    return {"commit": commit, "python": platform.python_version(), "platform": platform.platform(),
+            "cpus": os.cpu_count(), "timestamp": time.strftime("%Y-%m-%dT%H:%M:%S")}
+
+
+def compare(old_path, new_path, threshold=1.2):
+    """Prints new/old ratios of wall time and peak RSS per (instance, stage, config); flags slowdowns."""
+    def load(path):
+        with open(path) as f:
+            return {(r["instance"], r["stage"], r["config"]): r for r in json.load(f)["results"]}
+
+    old, new = load(old_path), load(new_path)
+    for key in sorted(new, key=str):
+        if key not in old:
+            continue
+        o, n = old[key], new[key]
+        ratios = []
+        for field in ("seconds", "peak_rss_mb"):
+            if o.get(field) and n.get(field) is not None:
+                ratios.append((field, n[field] / o[field]))
+        flag = " <-- regression" if any(r > threshold for _, r in ratios) else ""
+        print(f"{key[0]:>12} {key[1]:>9} {key[2] or '':>12}  "
+              + "  ".join(f"{f} x{r:.2f}" for f, r in ratios)
+              + (f"  objective {o.get('objective')} -> {n.get('objective')}" if "objective" in n else "") + flag)
+
+
+def main(argv=None):
+    ap = argparse.ArgumentParser(description="End-to-end pipeline benchmark over data_instance1-7.")
+    ap.add_argument("--instances", default="1,2,3,4,5,6,7")
+    ap.add_argument("--sizes", default=",".join(s[0] for s in SIZES))
+    ap.add_argument("--modes", default="mixed")
+    ap.add_argument("--scale", type=int, default=1, help="synthesize instances this many times larger")
+    ap.add_argument("--backend", default="highs", choices=("pulp", "highs", "heuristic"))
+    ap.add_argument("--time-limit", type=float, default=60.0, help="solver time limit per pool (s)")
+    ap.add_argument("--cost-model", default=None, help="exported cost model JSON for the features stage")
+    ap.add_argument("--workdir", default="bench_work")
+    ap.add_argument("--out", default="bench.json")
+    ap.add_argument("--compare", nargs=2, metavar=("OLD", "NEW"))
+    args = ap.parse_args(argv)
+
+    if args.compare:
+        compare(*args.compare)
+        return None
+
+    sizes = [s for s in SIZES if s[0] in args.sizes.split(",")]
+    modes = args.modes.split(",")
+    os.makedirs(args.workdir, exist_ok=True)
+    results = []
+    for k in [int(x) for x in args.instances.split(",")]:
+        folder = unpack(k, args.workdir)
+        name = f"instance{k}"
+        if args.scale > 1:
+            name = f"instance{k}x{args.scale}"
+            t0 = time.perf_counter()
+            folder = synthesize_instance(folder, Path(args.workdir) / name, args.scale)
+            print(f"Synthesized {name} in {time.perf_counter() - t0:.1f}s")
+        results.extend(benchmark_instance(name, folder, args.workdir, sizes, modes, args.backend, args.time_limit,
+                                          args.cost_model))
+
+    report = {"environment": _environment(), "settings": vars(args), "results": results}
+    with open(args.out, "w") as f:
+        json.dump(report, f, indent=1)
+    print(f"\nWrote {len(results)} results to {args.out}")
+    return report
+
+
+if __name__ == "__main__":
+    sys.path.insert(0, str(REPO))
+    main()
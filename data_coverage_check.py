@@ -1,184 +1,151 @@
 # -*- coding: utf-8 -*-
-"""Check-if_all_legs_are_covered_for_set_partitioning_model_requirements.ipynb
-
-Automatically generated by Colab.
-
-Original file is located at
-    https://colab.research.google.com/drive/1sdGRcEXmV0mrneC1ueAxXeZ9KVEK2xv0
 """
+data_coverage_check.py
 
+Exact-cover validator for sets of pairings against a compiled instance (instance_store.py). Replaces the Colab
+notebook that regex-scanned initialSolution.in and solution_0 several times.
 
+One pass over the CSR leg codes of a pairing set (the initial solution, the solution_0 schedules, or a solver's
+selected pairings) checks:
 
-# Read legs.csv manually
-all_legs = set()
-with open('/content/sample_data/legs.csv', 'r', encoding='utf-8') as f:
-    lines = f.readlines()
-
-# Skip the header and split by tab
-for line in lines[1:]:
-    parts = line.strip().split('\t')
-    if len(parts) >= 2:
-        leg_id = parts[1]
-        all_legs.add(leg_id)
-
-print(f"Total legs in legs.csv: {len(all_legs)}")
-
-# Now read initialsolution.in
-import re
-
-with open('/content/sample_data/initialSolution.in', 'r', encoding='utf-8') as f:
-    content = f.read()
-
-# Find all LEG_* entries
-legs_in_solution = set(re.findall(r'LEG_\d+_\d+', content))
-
-print(f"Total legs in initialsolution.in: {len(legs_in_solution)}")
-
-# Check missing legs
-missing_legs = all_legs - legs_in_solution
-print(f"Number of legs missing from initialsolution.in: {len(missing_legs)}")
-if missing_legs:
-    print("Missing legs:")
-    for leg in sorted(missing_legs):
-        print(leg)
-
-import re
-
-# Read solution_0.txt
-with open('/content/sample_data/solution_0.txt', 'r', encoding='utf-8') as f:
-    solution_content = f.read()
-
-# Find all LEG_* entries
-legs_in_solution_0 = set(re.findall(r'LEG_\d+_\d+', solution_content))
+    missing legs        flight legs of the instance that no set member flies
+    duplicated legs     flight legs flown by more than one member (or twice by the same member)
+    base mismatches     members whose first leg does not depart from, or whose last leg does not arrive at, their base
+    unknown ids         LEG_-like tokens that are not in the instance's day files
 
-print(f"Total legs covered in solution_0.txt: {len(legs_in_solution_0)}")
+Deadhead (TDH_) legs do not cover a leg: the crew rides along, so they are counted but never reported as duplicates.
+This settles what the notebook found by hand: TDH legs may appear in several pairings and must not be treated as
+set-partitioning rows. PAL_ legs are flown (solution_0 marks legs with PAL_ that the initial solution flies plainly).
+Other activity tokens (VACATION, POST_PAIRING, AGR_..., ...) are counted only.
 
-# Check which legs from initialsolution.in are missing in solution_0
-legs_missing_from_solution_0 = legs_in_solution - legs_in_solution_0
-print(f"Number of legs in initialsolution.in missing from solution_0.txt: {len(legs_missing_from_solution_0)}")
-if legs_missing_from_solution_0:
-    print("Missing legs:")
-    for leg in sorted(legs_missing_from_solution_0):
-        print(leg)
+Usage:
+    python data_coverage_check.py path/to/instanceN [initial|solution_0|all]
 
-# Optional: legs that appear in multiple pairings in solution_0
-from collections import Counter
-all_solution_legs = re.findall(r'LEG_\d+_\d+', solution_content)
-duplicates = [leg for leg, count in Counter(all_solution_legs).items() if count > 1]
-print(f"Legs appearing multiple times in solution_0.txt: {duplicates}")
-
-# checking to see if multiple legs appear in initialSolution.in
+prints one JSON report per set and exits with status 1 when any set fails, so it can gate a pipeline run.
+"""
 
+import json
 import re
-from collections import defaultdict
-
-# Path to your initialSolution.in file
-filename = "/content/sample_data/initialSolution.in"
-
-# Dictionary to track which pairings each leg appears in
-leg_to_pairings = defaultdict(list)
-
-# Read the file
-with open(filename, "r") as f:
-    data = f.read()
-
-# Find all pairings
-pairings = re.findall(r'Pairing \d+ : Base [^:]+ : (.*?);', data, re.DOTALL)
-
-for idx, pairing in enumerate(pairings, start=1):
-    # Split legs by comma and remove whitespace
-    legs = [leg.strip() for leg in pairing.split(',')]
-    for leg in legs:
-        leg_to_pairings[leg].append(idx)
-
-# Find legs that appear in more than one pairing
-multiple_legs = {leg: p for leg, p in leg_to_pairings.items() if len(p) > 1}
-
-print(f"Total legs in initialSolution.in: {len(leg_to_pairings)}")
-print(f"Legs appearing multiple times: {len(multiple_legs)}")
-if multiple_legs:
-    for leg, pair_list in multiple_legs.items():
-        print(f"{leg} appears in pairings: {pair_list}")
-
-import pulp
-
-# --- Define pairings ---
-# Each key is a pairing ID, each value is the list of legs it contains
-pairings = {
-    52: ["TDH_LEG_09_26", "TDH_LEG_09_16", "LEG_07_0", "LEG_07_1"],
-    73: ["TDH_LEG_09_26", "TDH_LEG_09_16", "LEG_08_23"],
-    1: ["LEG_29_1", "LEG_30_11", "LEG_30_0"],
-    2: ["LEG_29_3", "LEG_30_19", "LEG_30_21"],
-}
-
-# Optional: define a simple cost for each pairing
-costs = {k: len(v) for k, v in pairings.items()}  # e.g., minimize total number of legs per pairing
-
-# --- Create LP problem ---
-prob = pulp.LpProblem("SetPartitioningExample", pulp.LpMinimize)
-
-# --- Decision variables ---
-x = {p: pulp.LpVariable(f"x_{p}", cat="Binary") for p in pairings}
-
-# --- Objective: minimize total cost ---
-prob += pulp.lpSum(costs[p] * x[p] for p in pairings)
-
-# --- Constraints: each leg can appear in exactly one selected pairing ---
-# First, find all unique legs
-all_legs = set(leg for pair in pairings.values() for leg in pair)
-
-for leg in all_legs:
-    # Get all pairings containing this leg
-    pairings_with_leg = [p for p, legs in pairings.items() if leg in legs]
-    prob += pulp.lpSum(x[p] for p in pairings_with_leg) == 1, f"leg_{leg}_constraint"
-
-# --- Solve ---
-prob.solve()
-
-# --- Show solution ---
-print(f"Status: {pulp.LpStatus[prob.status]}")
-for p in pairings:
-    if pulp.value(x[p]) == 1:
-        print(f"Selected pairing {p}: {pairings[p]}")
-
-"""Issues with the above snippet logic:"""
-
-import pulp
-
-# --- Legs and Pairings ---
-legs = [
-    'TDH_LEG_09_26', 'TDH_LEG_09_16',
-    'LEG_07_0', 'LEG_07_1', 'LEG_08_23',
-    'LEG_29_1', 'LEG_30_11', 'LEG_30_0', 'LEG_29_3', 'LEG_30_19', 'LEG_30_21'
-]
-
-pairings = {
-    52: ['TDH_LEG_09_26', 'TDH_LEG_09_16', 'LEG_07_0', 'LEG_07_1'],
-    73: ['TDH_LEG_09_26', 'TDH_LEG_09_16', 'LEG_08_23'],
-    1:  ['LEG_29_1', 'LEG_30_11', 'LEG_30_0'],
-    2:  ['LEG_29_3', 'LEG_30_19', 'LEG_30_21']
-}
-
-# --- Create model ---
-prob = pulp.LpProblem("SetPartitioningExample", pulp.LpMinimize)
-
-# Decision variables
-x = {p: pulp.LpVariable(f"x_{p}", cat="Binary") for p in pairings}
-
-# Dummy objective (minimize total number of pairings selected)
-prob += pulp.lpSum(x.values())
-
-# Constraints: each leg appears exactly once
-for leg in legs:
-    prob += pulp.lpSum(x[p] for p in pairings if leg in pairings[p]) == 1, f"cover_{leg}"
-
-# Solve
-prob.solve()
-
-# --- Output results ---
-print("Status:", pulp.LpStatus[prob.status])
-for p in pairings:
-    if x[p].value() == 1:
-        print(f"Selected pairing {p}: {pairings[p]}")
-
-"""RESULT: TURNS OUT THAT THE ISSUE IS THAT TDH LEGS SHOULD NOT BE TREATED OR PENALIZED IN THE SET PARTITIONING PROBLEM. JUST NEED TO INCLUDE LOGIC SO THAT I"""
+import sys
+import time
+from array import array
+
+from instance_store import open_instance
+from leg_dictionary import LegDictionary, ID_MASK, is_deadhead
+
+LEG_TOKEN = re.compile(r"(?:TDH_|PAL_)*LEG_\d+_\d+$")
+
+
+def validate(instance, offsets, codes, bases, numbers=None, names=None, source=""):
+    """
+    Validates the pairing set stored as CSR (`offsets`, leg `codes`) with one base airport id per member in `bases`
+    (an out-of-range id marks an unknown base). `numbers` are the members' pairing/schedule numbers for the report
+    (default: positions) and `names` the LegDictionary the codes refer to (default: the instance's). Returns a
+    JSON-serializable report dict; `ok` is True when no check failed.
+    """
+    t0 = time.perf_counter()
+    names = names or instance.leg_dict
+    n_legs = len(instance)
+    dep_ap, arr_ap = instance.dep_airport, instance.arr_airport
+    flown = array("I", bytes(4 * n_legs))
+    first_member = array("i", [-1]) * n_legs
+    duplicated = {}
+    unknown = {}
+    mismatches = []
+    deadheads = activities = 0
+
+    for j in range(len(offsets) - 1):
+        first = last = -1
+        for code in codes[offsets[j]:offsets[j + 1]]:
+            lid = code & ID_MASK
+            if lid >= n_legs:
+                token = names.name(code)
+                if LEG_TOKEN.match(token):
+                    unknown[token] = unknown.get(token, 0) + 1
+                else:
+                    activities += 1
+                continue
+            if first < 0:
+                first = lid
+            last = lid
+            if is_deadhead(code):
+                deadheads += 1
+                continue
+            flown[lid] += 1
+            if first_member[lid] < 0:
+                first_member[lid] = j
+            elif flown[lid] == 2:
+                duplicated[lid] = [first_member[lid], j]
+            else:
+                duplicated[lid].append(j)
+
+        b = bases[j]
+        if first >= 0 and (dep_ap[first] != b or arr_ap[last] != b):
+            mismatches.append({
+                "member": numbers[j] if numbers is not None else j,
+                "base": instance.airports[b] if b < len(instance.airports) else None,
+                "departs": instance.airports[dep_ap[first]],
+                "arrives": instance.airports[arr_ap[last]],
+            })
+
+    label = (lambda j: numbers[j]) if numbers is not None else (lambda j: j)
+    missing = [instance.ids[lid] for lid in range(n_legs) if not flown[lid]]
+    report = {
+        "source": source,
+        "members": len(offsets) - 1,
+        "legs": n_legs,
+        "covered": n_legs - len(missing),
+        "missing": missing,
+        "duplicated": {instance.ids[lid]: [label(j) for j in members] for lid, members in duplicated.items()},
+        "base_mismatches": mismatches,
+        "unknown": unknown,
+        "deadheads": deadheads,
+        "activities": activities,
+    }
+    report["ok"] = not (missing or duplicated or mismatches or unknown)
+    report["seconds"] = round(time.perf_counter() - t0, 6)
+    return report
+
+
+def validate_initial(instance):
+    """Report for the instance's initial solution (initialSolution.in)."""
+    return validate(instance, instance.pair_off, instance.pair_codes, instance.pair_base, instance.pair_num,
+                    source="initialSolution.in")
+
+
+def validate_schedules(instance):
+    """Report for the solution_0 crew schedules; a schedule's base is checked against its first and last leg."""
+    return validate(instance, instance.sched_off, instance.sched_codes, instance.sched_base, instance.sched_num,
+                    source="solution_0")
+
+
+def validate_pairings(instance, pairings, source="solver"):
+    """
+    Report for pairing dicts in any phase's layout ("legs" or "duties" tokens, "base" name), e.g. the pairings a
+    Phase 4 solve selected. Tokens the instance has never seen are interned into a private copy of its dictionary,
+    so they show up as unknown ids instead of failing the lookup.
+    """
+    names = LegDictionary(instance.leg_dict.names)
+    offsets = array("I", [0])
+    codes = array("I")
+    bases = array("I")
+    for p in pairings:
+        codes.extend(names.encode(p["legs"] if "legs" in p else p["duties"]))
+        offsets.append(len(codes))
+        bases.append(instance.airport_index.get(p["base"], len(instance.airports)))
+    return validate(instance, offsets, codes, bases, names=names, source=source)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    which = sys.argv[2] if len(sys.argv) > 2 else "all"
+    with open_instance(sys.argv[1]) as instance:
+        reports = []
+        if which in ("initial", "all"):
+            reports.append(validate_initial(instance))
+        if which in ("solution_0", "all"):
+            reports.append(validate_schedules(instance))
+    print(json.dumps(reports, indent=1))
+    sys.exit(0 if all(r["ok"] for r in reports) else 1)
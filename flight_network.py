@@ -0,0 +1,357 @@
+# -*- coding: utf-8 -*-
+"""
+flight_network.py
+
+Flight-leg network built from an unpacked data_instanceN folder (day_*.csv and listOfBases.csv).
+
+The leg table is kept column-wise (airport ids, epoch-minute departure/arrival times) so that connection checks are
+plain integer comparisons. On top of it, FlightNetwork builds the leg-to-leg connection graph used by the
+column-generation pricing step: a resource-constrained shortest path over legs sorted by departure time, where every
+path starts and ends at the same crew base and respects the duty and pairing limits below.
+
+The default limits were read off the initial solutions shipped with data_instance1-7: every pairing starts and ends
+at its base, consecutive legs always connect airport-to-airport, sits are at least ~20 minutes, duties (legs separated
+by at most 4 hours) last at most 12 hours with at most 6 legs, and pairings span at most 4 days. A few shipped pairings
+break them and are left out on purpose rather than loosening the rules for everyone: 8 pairings of instance3 rest up
+to 57 hours between duties (over MAX_REST_MIN) and 1 pairing of instance6 has a 2-minute sit (under MIN_CONNECT_MIN).
+Those pairings fail is_legal/pairing_base; the generators never re-check initial pairings, and apply_leg_changes
+exempts them from the rule checks when given the initial solution.
+"""
+
+import csv
+import os
+from array import array
+from bisect import bisect_left, bisect_right
+from datetime import datetime
+
+import pipeline_trace as trace
+
+MIN_CONNECT_MIN = 20            # minimum sit between two legs
+MAX_SIT_MIN = 4 * 60            # longer gaps end the duty (rest / overnight)
+MAX_REST_MIN = 36 * 60          # longest rest allowed between two duties
+MAX_DUTY_MIN = 12 * 60          # first departure to last arrival within one duty
+MAX_DUTY_LEGS = 6
+MAX_PAIRING_MIN = 4 * 24 * 60   # first departure to last arrival of the pairing
+
+EPOCH = datetime(1970, 1, 1)
+
+
+def _to_epoch_minutes(date_str, hour_str):
+    dt = datetime.strptime(f"{date_str} {hour_str}", "%Y-%m-%d %H:%M")
+    return int((dt - EPOCH).total_seconds() // 60)
+
+
+class LegTable:
+    """
+    Column-wise leg table: position k holds leg `ids[k]` departing `dep_airport[k]` at `dep_min[k]` and arriving at
+    `arr_airport[k]` at `arr_min[k]`. Airports are interned into `airports`; times are minutes since 1970-01-01.
+    """
+
+    def __init__(self):
+        self.ids = []
+        self.index = {}              # leg_id -> position
+        self.airports = []
+        self.airport_index = {}      # airport name -> id
+        self.dep_airport = array("I")
+        self.arr_airport = array("I")
+        self.dep_min = array("i")
+        self.arr_min = array("i")
+
+    def __len__(self):
+        return len(self.ids)
+
+    def airport_id(self, name):
+        aid = self.airport_index.get(name)
+        if aid is None:
+            aid = self.airport_index[name] = len(self.airports)
+            self.airports.append(name)
+        return aid
+
+    def add(self, leg_id, dep_airport, dep_min, arr_airport, arr_min):
+        if leg_id in self.index:
+            k = self.index[leg_id]
+            self.dep_airport[k] = self.airport_id(dep_airport)
+            self.arr_airport[k] = self.airport_id(arr_airport)
+            self.dep_min[k] = dep_min
+            self.arr_min[k] = arr_min
+            return k
+        k = self.index[leg_id] = len(self.ids)
+        self.ids.append(leg_id)
+        self.dep_airport.append(self.airport_id(dep_airport))
+        self.arr_airport.append(self.airport_id(arr_airport))
+        self.dep_min.append(dep_min)
+        self.arr_min.append(arr_min)
+        return k
+
+
+@trace.traced("parse.day_files")
+def parse_day_files(instance_folder, num_days=31):
+    """
+    Loads day_1.csv .. day_31.csv into a LegTable. Like the Phase 2 loader, the delimiter (tab or comma) is detected
+    from the header, column names are normalized, arrivals earlier than departures are pushed to the next day, and
+    bad rows are counted and skipped rather than aborting the load.
+    """
+    legs = LegTable()
+    files_loaded = 0
+    error_rows = 0
+
+    for day_num in range(1, num_days + 1):
+        filepath = os.path.join(instance_folder, f"day_{day_num}.csv")
+        if not os.path.exists(filepath):
+            continue
+
+        with open(filepath, "r", encoding="utf-8") as f:
+            first_line = f.readline()
+            delimiter = "\t" if "\t" in first_line else ","
+            header = [c.strip().lstrip("#").lower() for c in first_line.split(delimiter)]
+            try:
+                col = {name: header.index(name) for name in (
+                    "leg_nb", "airport_dep", "date_dep", "hour_dep", "airport_arr", "date_arr", "hour_arr")}
+            except ValueError:
+                print(f"  Error reading {filepath}: missing required columns")
+                continue
+
+            for row in csv.reader(f, delimiter=delimiter):
+                if not row or not "".join(row).strip():
+                    continue
+                try:
+                    row = [c.strip() for c in row]
+                    dep = _to_epoch_minutes(row[col["date_dep"]], row[col["hour_dep"]])
+                    arr = _to_epoch_minutes(row[col["date_arr"]], row[col["hour_arr"]])
+                    # Handle overnight flights
+                    if arr < dep:
+                        arr += 24 * 60
+                    legs.add(row[col["leg_nb"]], row[col["airport_dep"]], dep, row[col["airport_arr"]], arr)
+                except (IndexError, ValueError):
+                    error_rows += 1
+
+        files_loaded += 1
+
+    print(f"Loaded {files_loaded} day files | {len(legs)} legs | {error_rows} bad rows")
+    trace.count("parse.legs", len(legs))
+    trace.count("parse.bad_rows", error_rows)
+    return legs
+
+
+def load_bases(instance_folder):
+    """Reads listOfBases.csv and returns {base airport: nbEmployees} for the rows flagged isBase == 1."""
+    path = os.path.join(instance_folder, "listOfBases.csv")
+    bases = {}
+    if not os.path.exists(path):
+        return bases
+    with open(path, "r", encoding="utf-8") as f:
+        reader = csv.reader(f)
+        header = [c.strip().lower() for c in next(reader)]
+        # older instances name the flag column "status" instead of "isBase"
+        flag = "isbase" if "isbase" in header else "status"
+        a, b, e = header.index("airport"), header.index(flag), header.index("nbemployees")
+        for row in reader:
+            row = [c.strip() for c in row]
+            if len(row) > max(a, b, e) and row[b] == "1":
+                bases[row[a]] = int(row[e])
+    return bases
+
+
+class FlightNetwork:
+    """
+    Leg-connection graph over a LegTable plus the crew bases.
+
+    `successors(k)` lists the legs that may follow leg k in a pairing: same airport, at least MIN_CONNECT_MIN later and
+    at most MAX_REST_MIN later, in departure order. The lists are stored back to back in CSR form (`succ_ptr`,
+    `succ_idx`), so the graph is two flat arrays that are cheap to ship to worker processes. Legs are also kept in
+    departure order (`order`), which is a topological order of the graph because every connection moves forward in time.
+    """
+
+    def __init__(self, legs, bases, min_connect=MIN_CONNECT_MIN, max_sit=MAX_SIT_MIN, max_rest=MAX_REST_MIN,
+                 max_duty=MAX_DUTY_MIN, max_duty_legs=MAX_DUTY_LEGS, max_pairing=MAX_PAIRING_MIN):
+        self.legs = legs
+        self.bases = dict(bases)
+        self.base_ids = {legs.airport_id(b) for b in self.bases}
+        self.min_connect = min_connect
+        self.max_sit = max_sit
+        self.max_rest = max_rest
+        self.max_duty = max_duty
+        self.max_duty_legs = max_duty_legs
+        self.max_pairing = max_pairing
+
+        n = len(legs)
+        dep, arr = legs.dep_min, legs.arr_min
+        self.order = sorted(range(n), key=lambda k: dep[k])
+
+        # departures per airport in time order, so successors are a contiguous window of that list
+        by_airport = {}
+        for k in self.order:
+            by_airport.setdefault(legs.dep_airport[k], []).append(k)
+        dep_times = {ap: [dep[k] for k in ks] for ap, ks in by_airport.items()}
+
+        self.succ_ptr = array("I", [0])
+        self.succ_idx = array("I")
+        with trace.span("network.successors", legs=n):
+            for k in range(n):
+                ap = legs.arr_airport[k]
+                if ap in by_airport:
+                    times = dep_times[ap]
+                    lo = bisect_left(times, arr[k] + min_connect)
+                    hi = bisect_right(times, arr[k] + max_rest)
+                    self.succ_idx.extend(by_airport[ap][lo:hi])
+                self.succ_ptr.append(len(self.succ_idx))
+        trace.count("network.connections", len(self.succ_idx))
+
+    @classmethod
+    def from_instance(cls, instance_folder, **limits):
+        return cls(parse_day_files(instance_folder), load_bases(instance_folder), **limits)
+
+    def successors(self, k):
+        """Legs that may follow leg k, in departure order."""
+        return self.succ_idx[self.succ_ptr[k]:self.succ_ptr[k + 1]]
+
+    def connects(self, k, j):
+        """True when leg j may directly follow leg k (same airport, sit between min_connect and max_rest)."""
+        legs = self.legs
+        sit = legs.dep_min[j] - legs.arr_min[k]
+        return legs.arr_airport[k] == legs.dep_airport[j] and self.min_connect <= sit <= self.max_rest
+
+    def start(self, k):
+        """Rule state of a pairing whose first leg is k: (pairing start, duty start, legs in the current duty)."""
+        t = self.legs.dep_min[k]
+        return t, t, 1
+
+    def step(self, state, k, j):
+        """
+        Rule state after flying leg j right after leg k, or None when the connection, duty or pairing limits forbid
+        it. Constant time, so a pairing can be checked (or grown) leg by leg.
+        """
+        legs = self.legs
+        if not self.connects(k, j):
+            return None
+        start, duty_start, duty_legs = state
+        arr_j = legs.arr_min[j]
+        if arr_j - start > self.max_pairing:
+            return None
+        if legs.dep_min[j] - legs.arr_min[k] <= self.max_sit:
+            if duty_legs >= self.max_duty_legs or arr_j - duty_start > self.max_duty:
+                return None
+            return start, duty_start, duty_legs + 1
+        return start, legs.dep_min[j], 1
+
+    def _home(self, path):
+        """Airport id a legal leg path starts and ends at (any airport, not only bases), else None."""
+        legs = self.legs
+        n = len(legs)
+        if not path or path[0] >= n or path[-1] >= n:
+            return None
+        b = legs.dep_airport[path[0]]
+        if legs.arr_airport[path[-1]] != b:
+            return None
+        state = self.start(path[0])
+        for k, j in zip(path, path[1:]):
+            if j >= n:
+                return None
+            state = self.step(state, k, j)
+            if state is None:
+                return None
+        return b
+
+    def pairing_base(self, path):
+        """
+        Crew base (airport name) of the leg positions `path` when they form a legal pairing, else None. A pairing is
+        legal when it starts and ends at the same base and every step passes `step`.
+        """
+        b = self._home(path)
+        return self.legs.airports[b] if b in self.base_ids else None
+
+    def is_legal(self, path, base):
+        """
+        True when the leg positions `path` (in flying order, deadheads included) form a pairing under the network's
+        rules: it starts and ends at `base`, consecutive legs connect at the same airport with a sit between
+        min_connect and max_rest, and the duty and pairing limits hold.
+        """
+        b = self.legs.airport_index.get(base)
+        return b is not None and self._home(path) == b
+
+    def price(self, duals, leg_cost=1.0, fixed_cost=0.0, max_columns=200, labels_per_node=4, eps=1e-6):
+        """
+        Pricing step for column generation: a labeling resource-constrained shortest path over the legs in departure order.
+
+        `duals` maps leg positions to the dual price of their covering row; legs missing from it are not rows of the
+        master and are never used. A pairing costs `fixed_cost + leg_cost * n_legs`, so its reduced cost is
+        accumulated leg by leg. Labels track the pairing start, the current duty start and the legs in that duty;
+        dominated labels are dropped and at most `labels_per_node` labels are kept per (leg, base), which makes this a
+        heuristic pricer on large networks. Returns up to `max_columns` (reduced_cost, base, [leg positions]) with
+        negative reduced cost, most negative first.
+        """
+        legs = self.legs
+        dep, arr = legs.dep_min, legs.arr_min
+        dep_ap, arr_ap = legs.dep_airport, legs.arr_airport
+
+        # label: (reduced_cost, pairing_start, duty_start, duty_legs, node, parent_label)
+        labels = {}
+        found = []
+
+        for k in self.order:
+            if k not in duals:
+                continue
+            node_labels = labels.pop(k, {})
+            if dep_ap[k] in self.base_ids:
+                node_labels.setdefault(dep_ap[k], []).append(
+                    (fixed_cost + leg_cost - duals[k], dep[k], dep[k], 1, k, None))
+
+            for base, labs in node_labels.items():
+                labs = _prune_labels(labs, labels_per_node)
+                for lab in labs:
+                    rc, start, duty_start, duty_legs = lab[0], lab[1], lab[2], lab[3]
+                    if arr_ap[k] == base and rc < -eps:
+                        found.append((rc, base, lab))
+
+                    for j in self.successors(k):
+                        dj = duals.get(j)
+                        if dj is None or arr[j] - start > self.max_pairing:
+                            continue
+                        if dep[j] - arr[k] <= self.max_sit:
+                            if duty_legs >= self.max_duty_legs or arr[j] - duty_start > self.max_duty:
+                                continue
+                            nxt = (rc + leg_cost - dj, start, duty_start, duty_legs + 1, j, lab)
+                        else:
+                            nxt = (rc + leg_cost - dj, start, dep[j], 1, j, lab)
+                        bucket = labels.setdefault(j, {}).setdefault(base, [])
+                        bucket.append(nxt)
+                        if len(bucket) > 8 * labels_per_node:
+                            bucket[:] = _prune_labels(bucket, labels_per_node)
+
+        found.sort(key=lambda t: t[0])
+        columns = []
+        seen = set()
+        for rc, base, lab in found:
+            path = []
+            while lab is not None:
+                path.append(lab[4])
+                lab = lab[5]
+            path.reverse()
+            key = tuple(path)
+            if key in seen:
+                continue
+            seen.add(key)
+            columns.append((rc, legs.airports[base], path))
+            if len(columns) >= max_columns:
+                break
+        return columns
+
+
+def _prune_labels(labs, keep):
+    """
+    Drops dominated labels (no better reduced cost and no more slack on any resource than another label) and keeps
+    the `keep` cheapest of the rest.
+    """
+    labs.sort(key=lambda t: t[0])
+    kept = []
+    for lab in labs:
+        dominated = False
+        for other in kept:
+            if other[1] >= lab[1] and other[2] >= lab[2] and other[3] <= lab[3]:
+                dominated = True
+                break
+        if not dominated:
+            kept.append(lab)
+            if len(kept) >= keep:
+                break
+    return kept
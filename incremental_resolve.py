@@ -0,0 +1,112 @@
+# -*- coding: utf-8 -*-
+"""
+incremental_resolve.py
+
+Incremental re-solve after a handful of legs of an instance were edited in day_*.csv (retimes, re-routes,
+cancellations, added flights).
+
+The edited day files are diffed against the instance's last compiled store (instance_store.py). Only the pairings
+touching changed legs are invalidated or re-costed, the loaded SPPFromCSV is patched in place
+(SPPFromCSV.apply_leg_changes) and the problem is re-solved from the previous incumbent and, with HiGHS, from the
+previous model and basis. Legs left uncovered (new flights, or legs whose only pairings were removed) are filled by a
+few rounds of column generation over the edited network. Finally the store is recompiled, so the next edit is diffed
+against this version.
+
+Usage:
+    python incremental_resolve.py path/to/instanceN [pulp|highs|heuristic]
+"""
+
+import os
+import sys
+import time
+
+from flight_network import FlightNetwork, parse_day_files, load_bases
+from instance_store import CompiledInstance, compile_instance, open_instance, DEFAULT_NAME
+
+
+class LegDiff:
+    """Leg names added, removed (cancelled) and changed (retimed or re-routed) between two leg tables."""
+
+    def __init__(self, added, removed, changed):
+        self.added = added
+        self.removed = removed
+        self.changed = changed
+
+    def __bool__(self):
+        return bool(self.added or self.removed or self.changed)
+
+    def __str__(self):
+        return f"{len(self.changed)} changed, {len(self.removed)} removed, {len(self.added)} added legs"
+
+
+def diff_legs(old, new):
+    """Compares two LegTable-like objects (a CompiledInstance and a freshly parsed LegTable) leg by leg."""
+    added = [leg for leg in new.ids if leg not in old.index]
+    removed = [leg for leg in old.ids if leg not in new.index]
+    changed = []
+    for leg in new.ids:
+        k = old.index.get(leg)
+        if k is None:
+            continue
+        q = new.index[leg]
+        if (old.dep_min[k] != new.dep_min[q] or old.arr_min[k] != new.arr_min[q]
+                or old.airports[old.dep_airport[k]] != new.airports[new.dep_airport[q]]
+                or old.airports[old.arr_airport[k]] != new.airports[new.arr_airport[q]]):
+            changed.append(leg)
+    return LegDiff(added, removed, changed)
+
+
+def resolve_incremental(solver, instance_folder, backend="highs", time_limit=None, cost_fn=None, max_rounds=10):
+    """
+    Diffs the instance's day files against its compiled store, patches `solver` (an SPPFromCSV holding the last
+    solved pool and solution) and re-solves. `cost_fn(pairing dicts) -> costs` re-costs the touched pairings, e.g. a
+    wrapper around Phase 2's CompiledCostModel.score_pairings; without it they keep their current costs.
+    Returns the selected pairing indices of the patched pool.
+    """
+    t0 = time.perf_counter()
+    store = os.path.join(instance_folder, DEFAULT_NAME)
+    if not os.path.exists(store):
+        raise FileNotFoundError(f"{store} not found — compile the instance before editing it")
+
+    old = CompiledInstance(store)
+    new = parse_day_files(instance_folder)
+    diff = diff_legs(old, new)
+    initial = [old.leg_dict.decode(old.pairing(j)) for j in range(old.n_pairings)]
+    old.close()
+    print(f"Leg diff against {store}: {diff}")
+    if not diff:
+        return solver.solution
+
+    network = FlightNetwork(new, load_bases(instance_folder))
+    incumbent = solver.apply_leg_changes(diff, network, cost_fn, initial)
+
+    if any(k == 0 for k in solver.a.row_counts()):
+        selected = solver.solve_column_generation(network, max_rounds=max_rounds, backend=backend,
+                                                  time_limit=time_limit)
+    else:
+        selected = solver.solve_spp(backend=backend, time_limit=time_limit, incumbent=incumbent or None,
+                                    warm_model=True)
+
+    compile_instance(instance_folder, store)
+    print(f"Incremental re-solve finished in {time.perf_counter() - t0:.2f}s")
+    return selected
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    from phase_4_set_partitioning_solvers_3 import SPPFromCSV
+
+    folder = sys.argv[1]
+    backend = sys.argv[2] if len(sys.argv) > 2 else "highs"
+
+    # baseline: the pool and solution of the last compiled version of the instance
+    instance = open_instance(folder)
+    solver = SPPFromCSV(folder)
+    solver.load_compiled(instance)
+    solver.load_costs_csv()
+    solver.solve_spp(backend=backend)
+    instance.close()
+
+    resolve_incremental(solver, folder, backend=backend)
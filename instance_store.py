@@ -0,0 +1,298 @@
+# -*- coding: utf-8 -*-
+"""
+instance_store.py
+
+One-time compiler from an unpacked data_instanceN folder to a versioned, memory-mappable binary file, and the
+zero-copy reader every later stage opens instead of re-parsing 31 day files and the solution texts.
+
+File layout (little-endian):
+    header      magic b"CRWI", u32 version, u32 section count
+    directory   per section: 16-byte name, 1-byte array typecode, 7 pad bytes, u64 offset, u64 item count
+    sections    8-byte aligned raw arrays
+
+Sections:
+    leg table       leg_dep_ap / leg_arr_ap (airport ids), leg_dep_min / leg_arr_min (epoch minutes)
+    strings         token_blob + token_off (LegDictionary names: flight legs first, then other activity tokens such
+                    as VACATION), airport_blob + airport_off, emp_blob + emp_off
+    bases           base_ap (airport id), base_emp (nbEmployees)
+    pairings (CSR)  pair_off, pair_codes (leg codes), pair_base (airport id), pair_num (pairing number)
+    schedules (CSR) sched_off, sched_codes (activity codes), sched_base (airport id), sched_num, sched_emp
+
+Usage:
+    python instance_store.py path/to/instanceN [out.bin]
+"""
+
+import os
+import re
+import struct
+import sys
+import mmap
+from array import array
+
+import pipeline_trace as trace
+from flight_network import parse_day_files, load_bases
+from leg_dictionary import LegDictionary, PairingArena
+
+MAGIC = b"CRWI"
+VERSION = 1
+DEFAULT_NAME = "instance.bin"
+
+_HEADER = struct.Struct("<4sII")
+_ENTRY = struct.Struct("<16sc7xQQ")
+
+SCHEDULE_PATTERN = re.compile(r'schedule\s+(\d+)\s+(\w+)\s+\((\w+)\)\s*:\s*([^;]+)')
+
+
+def _string_table(strings):
+    blob = bytearray()
+    off = array("I", [0])
+    for s in strings:
+        blob += s.encode("utf-8")
+        off.append(len(blob))
+    return array("B", bytes(blob)), off
+
+
+def _read_pairings(path, legs, airport_id):
+    """initialSolution.in through the tolerant Phase 0 line parser."""
+    from phase_0_prep_the_data import parse_line
+
+    arena = PairingArena()
+    numbers = array("I")
+    if not os.path.exists(path):
+        return arena, numbers
+    rows = []
+    with open(path, "r", encoding="utf-8") as f:
+        for raw in f:
+            r = parse_line(raw)
+            if r is not None and r[0] == "OK":
+                rows.append(r)
+    rows.sort(key=lambda r: r[1])
+    for _, pid, base, tokens, _ in rows:
+        arena.append(legs.encode(tokens), airport_id(base))
+        numbers.append(pid)
+    return arena, numbers
+
+
+def _read_schedules(path, legs, airport_id):
+    """solution_0 schedules: `schedule N EMPxxx (BASEk) : ACT--->ACT--->...;`."""
+    arena = PairingArena()
+    numbers = array("I")
+    employees = []
+    if not os.path.exists(path):
+        return arena, numbers, employees
+    with open(path, "r", encoding="utf-8") as f:
+        content = f.read()
+    for num, emp, base, activities in SCHEDULE_PATTERN.findall(content):
+        acts = [a.strip() for a in activities.split("--->") if a.strip()]
+        arena.append(legs.encode(acts), airport_id(base))
+        numbers.append(int(num))
+        employees.append(emp)
+    return arena, numbers, employees
+
+
+@trace.traced("instance.compile")
+def compile_instance(instance_folder, out_path=None):
+    """
+    Parses day_*.csv, listOfBases.csv, initialSolution.in and solution_0 of one instance folder and writes the
+    binary store. Returns the output path (default: instance.bin inside the folder).
+    """
+    out_path = out_path or os.path.join(instance_folder, DEFAULT_NAME)
+
+    table = parse_day_files(instance_folder)
+    bases = load_bases(instance_folder)
+    legs = LegDictionary.from_leg_table(table)
+
+    with trace.span("instance.read_pairings"):
+        pairings, pair_num = _read_pairings(
+            os.path.join(instance_folder, "initialSolution.in"), legs, table.airport_id)
+    with trace.span("instance.read_schedules"):
+        schedules, sched_num, employees = _read_schedules(
+            os.path.join(instance_folder, "solution_0"), legs, table.airport_id)
+    trace.count("instance.codes", len(pairings.codes) + len(schedules.codes))
+
+    token_blob, token_off = _string_table(legs.names)
+    airport_blob, airport_off = _string_table(table.airports)
+    emp_blob, emp_off = _string_table(employees)
+
+    sections = [
+        ("leg_dep_ap", table.dep_airport),
+        ("leg_arr_ap", table.arr_airport),
+        ("leg_dep_min", table.dep_min),
+        ("leg_arr_min", table.arr_min),
+        ("token_blob", token_blob),
+        ("token_off", token_off),
+        ("airport_blob", airport_blob),
+        ("airport_off", airport_off),
+        ("base_ap", array("I", [table.airport_id(b) for b in bases])),
+        ("base_emp", array("I", bases.values())),
+        ("pair_off", pairings.offsets),
+        ("pair_codes", pairings.codes),
+        ("pair_base", pairings.bases),
+        ("pair_num", pair_num),
+        ("sched_off", schedules.offsets),
+        ("sched_codes", schedules.codes),
+        ("sched_base", schedules.bases),
+        ("sched_num", sched_num),
+        ("emp_blob", emp_blob),
+        ("emp_off", emp_off),
+    ]
+
+    offset = _HEADER.size + _ENTRY.size * len(sections)
+    directory = []
+    for name, arr in sections:
+        offset = (offset + 7) & ~7
+        directory.append((name, arr, offset))
+        offset += arr.itemsize * len(arr)
+
+    with open(out_path, "wb") as f:
+        f.write(_HEADER.pack(MAGIC, VERSION, len(sections)))
+        for name, arr, off in directory:
+            f.write(_ENTRY.pack(name.encode("ascii"), arr.typecode.encode("ascii"), off, len(arr)))
+        for name, arr, off in directory:
+            f.write(b"\0" * (off - f.tell()))
+            if sys.byteorder != "little":
+                arr = array(arr.typecode, arr)
+                arr.byteswap()
+            f.write(arr.tobytes())
+
+    print(f"Compiled {instance_folder} -> {out_path}: {len(table)} legs, {len(bases)} bases, "
+          f"{len(pairings)} pairings, {len(schedules)} schedules")
+    return out_path
+
+
+class CompiledInstance:
+    """
+    Read-only view of a compiled instance. Numeric sections are memoryviews straight into the mapped file (no
+    copies); the small string tables are decoded once on open.
+
+    The object duck-types as a flight_network.LegTable (ids, index, airports, dep_airport, arr_airport, dep_min,
+    arr_min), so FlightNetwork(instance, instance.bases) works on it directly. Pickling sends only the path: a worker
+    process that receives the instance (or a FlightNetwork over it) maps the same file instead of getting a copy.
+    """
+
+    def __init__(self, path):
+        self.path = path
+        self._file = open(path, "rb")
+        self._mm = mmap.mmap(self._file.fileno(), 0, access=mmap.ACCESS_READ)
+        buf = memoryview(self._mm)
+
+        magic, version, count = _HEADER.unpack_from(buf, 0)
+        if magic != MAGIC:
+            raise ValueError(f"{path} is not a compiled instance")
+        if version != VERSION:
+            raise ValueError(f"{path} has store version {version}, expected {VERSION} — recompile it")
+
+        self._sections = {}
+        for k in range(count):
+            name, typecode, off, n = _ENTRY.unpack_from(buf, _HEADER.size + k * _ENTRY.size)
+            typecode = typecode.decode("ascii")
+            size = array(typecode).itemsize
+            view = buf[off:off + n * size]
+            if sys.byteorder == "little":
+                view = view.cast(typecode)
+            else:
+                swapped = array(typecode, view.tobytes())
+                swapped.byteswap()
+                view = memoryview(swapped)
+            self._sections[name.rstrip(b"\0").decode("ascii")] = view
+
+        sec = self._sections
+        self.dep_airport = sec["leg_dep_ap"]
+        self.arr_airport = sec["leg_arr_ap"]
+        self.dep_min = sec["leg_dep_min"]
+        self.arr_min = sec["leg_arr_min"]
+        self.pair_off, self.pair_codes = sec["pair_off"], sec["pair_codes"]
+        self.pair_base, self.pair_num = sec["pair_base"], sec["pair_num"]
+        self.sched_off, self.sched_codes = sec["sched_off"], sec["sched_codes"]
+        self.sched_base, self.sched_num = sec["sched_base"], sec["sched_num"]
+
+        self.airports = self._strings("airport")
+        self.airport_index = {a: i for i, a in enumerate(self.airports)}
+        self.leg_dict = LegDictionary(self._strings("token"))
+        self.ids = self.leg_dict.names[:len(self.dep_min)]
+        self.index = {leg: i for i, leg in enumerate(self.ids)}
+        self.employees = self._strings("emp")
+        self.bases = {self.airports[a]: e for a, e in zip(sec["base_ap"], sec["base_emp"])}
+
+    def __reduce__(self):
+        return self.__class__, (self.path,)
+
+    def _strings(self, prefix):
+        blob = self._sections[prefix + "_blob"]
+        off = self._sections[prefix + "_off"]
+        raw = bytes(blob)
+        return [raw[off[k]:off[k + 1]].decode("utf-8") for k in range(len(off) - 1)]
+
+    def __len__(self):
+        return len(self.dep_min)
+
+    def airport_id(self, name):
+        return self.airport_index[name]
+
+    @property
+    def n_pairings(self):
+        return len(self.pair_off) - 1
+
+    @property
+    def n_schedules(self):
+        return len(self.sched_off) - 1
+
+    def pairing(self, j):
+        """Leg codes of initial-solution pairing j (a zero-copy slice)."""
+        return self.pair_codes[self.pair_off[j]:self.pair_off[j + 1]]
+
+    def schedule(self, s):
+        """Activity codes of schedule s (a zero-copy slice)."""
+        return self.sched_codes[self.sched_off[s]:self.sched_off[s + 1]]
+
+    @property
+    def closed(self):
+        return self._mm is None
+
+    def close(self):
+        """
+        Unmaps the file. Slices and views handed out (pairing(), schedule(), a FlightNetwork's leg times, NumPy
+        arrays over a section) may outlive the store: while any is alive the mapping cannot be closed, so it is left
+        to be unmapped once the last of them is collected, and close() never raises over it (inside a `with` block
+        that would mask the exception being propagated). Closing twice is a no-op.
+        """
+        if self._mm is None:
+            return
+        for view in self._sections.values():
+            try:
+                view.release()
+            except BufferError:          # something still exports this view; it goes with its last reference
+                pass
+        self._sections.clear()
+        self.dep_airport = self.arr_airport = self.dep_min = self.arr_min = None
+        self.pair_off = self.pair_codes = self.pair_base = self.pair_num = None
+        self.sched_off = self.sched_codes = self.sched_base = self.sched_num = None
+        try:
+            self._mm.close()
+        except BufferError:
+            pass
+        self._mm = None
+        self._file.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+def open_instance(path):
+    """Opens a compiled store; given an instance folder, opens (compiling first if needed) its instance.bin."""
+    if os.path.isdir(path):
+        store = os.path.join(path, DEFAULT_NAME)
+        if not os.path.exists(store):
+            compile_instance(path, store)
+        path = store
+    return CompiledInstance(path)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    compile_instance(sys.argv[1], sys.argv[2] if len(sys.argv) > 2 else None)
@@ -0,0 +1,213 @@
+# -*- coding: utf-8 -*-
+"""
+leg_dictionary.py
+
+One leg dictionary per instance, shared by every phase.
+
+Each distinct flight leg (LEG_05_27, AGR_03_4, ...) gets a dense integer id. Deadhead (TDH_) and PAL_ markers are
+not separate entries; they are kept in the two top bits of the 32-bit code, so TDH_LEG_05_27 and LEG_05_27 share the
+same leg id and differ only in their flag bits. Pairings are then plain integer spans: hashing, comparison and
+incidence construction run on ints instead of heap strings.
+
+When the dictionary is built from a flight_network.LegTable, leg ids coincide with the leg table positions, so the
+columnar dep/arr arrays can be indexed directly with `leg_id(code)`.
+"""
+
+from array import array
+
+FLAG_TDH = 1 << 31
+FLAG_PAL = 1 << 30
+ID_MASK = FLAG_PAL - 1
+
+_PREFIXES = (("TDH_", FLAG_TDH), ("PAL_", FLAG_PAL))
+
+
+def leg_id(code):
+    """Dense leg id of a code, without the deadhead/PAL flags."""
+    return code & ID_MASK
+
+
+def is_deadhead(code):
+    return bool(code & FLAG_TDH)
+
+
+def is_pal(code):
+    return bool(code & FLAG_PAL)
+
+
+class LegDictionary:
+    """
+    Interning table from leg tokens to 32-bit codes: `code = leg id | flags`.
+
+    `encode`/`decode` convert whole duty sequences; tokens round-trip exactly as long as the TDH_ marker, when both
+    are present, comes before PAL_ (the only order seen in the data).
+    """
+
+    def __init__(self, leg_ids=()):
+        self.names = []              # leg id -> bare leg name
+        self.index = {}              # bare leg name -> leg id
+        self._codes = {}             # full token -> code (cache)
+        for name in leg_ids:
+            self._intern(name)
+
+    @classmethod
+    def from_leg_table(cls, legs):
+        """Dictionary whose leg ids equal the positions of a flight_network.LegTable."""
+        return cls(legs.ids)
+
+    def __len__(self):
+        return len(self.names)
+
+    def _intern(self, name):
+        lid = self.index.get(name)
+        if lid is None:
+            lid = self.index[name] = len(self.names)
+            self.names.append(name)
+        return lid
+
+    def code(self, token):
+        """Code of a leg token, interning the bare leg on first sight."""
+        c = self._codes.get(token)
+        if c is not None:
+            return c
+        flags = 0
+        name = token
+        for prefix, flag in _PREFIXES:
+            if name.startswith(prefix):
+                flags |= flag
+                name = name[len(prefix):]
+        c = self._codes[token] = self._intern(name) | flags
+        return c
+
+    def lookup(self, token):
+        """Code of a token without interning; None for a leg the dictionary has never seen."""
+        c = self._codes.get(token)
+        if c is not None:
+            return c
+        flags = 0
+        name = token
+        for prefix, flag in _PREFIXES:
+            if name.startswith(prefix):
+                flags |= flag
+                name = name[len(prefix):]
+        lid = self.index.get(name)
+        return None if lid is None else lid | flags
+
+    def name(self, code):
+        """Token for a code, with its TDH_/PAL_ markers restored."""
+        out = self.names[code & ID_MASK]
+        if code & FLAG_PAL:
+            out = "PAL_" + out
+        if code & FLAG_TDH:
+            out = "TDH_" + out
+        return out
+
+    def encode(self, tokens):
+        return [self.code(t) for t in tokens]
+
+    def decode(self, codes):
+        return [self.name(c) for c in codes]
+
+
+# Polynomial (Rabin-Karp) hashing of code spans modulo the Mersenne prime 2^61 - 1. Keys are plain ints below 2^61,
+# identical in every process, and the key of any window of a span follows from the span's prefix hashes in O(1).
+HASH_MOD = (1 << 61) - 1
+HASH_BASE = 0x5BD1E995_9E3779B1 % HASH_MOD
+_POW = [1]
+
+
+def _powers(n):
+    """HASH_BASE**k mod HASH_MOD for k = 0..n (the shared table grows on demand)."""
+    while len(_POW) <= n:
+        _POW.append(_POW[-1] * HASH_BASE % HASH_MOD)
+    return _POW
+
+
+def span_key(codes):
+    """61-bit key of an integer leg span; equals span_prefix(codes)[-1] and window_key over the whole span."""
+    h = 0
+    for c in codes:
+        h = (h * HASH_BASE + c + 1) % HASH_MOD
+    return h
+
+
+def span_prefix(codes):
+    """Prefix hashes of `codes`: entry i is span_key(codes[:i]), so the array has len(codes) + 1 entries."""
+    _powers(len(codes))
+    prefix = array("Q", [0])
+    h = 0
+    for c in codes:
+        h = (h * HASH_BASE + c + 1) % HASH_MOD
+        prefix.append(h)
+    return prefix
+
+
+def window_key(prefix, a, b, skip=-1):
+    """
+    span_key of codes[a:b] without position `skip` (none when outside a..b-1), from the prefix hashes of `codes`
+    alone: the sequence itself is never built.
+    """
+    pw = _POW if len(_POW) > b else _powers(b)   # the table is per process; spawned workers start empty
+    if a <= skip < b:
+        left = prefix[skip] - prefix[a] * pw[skip - a]
+        right = prefix[b] - prefix[skip + 1] * pw[b - skip - 1]
+        return (left * pw[b - skip - 1] + right) % HASH_MOD
+    return (prefix[b] - prefix[a] * pw[b - a]) % HASH_MOD
+
+
+def joined_key(prefix1, cut, prefix2, t):
+    """span_key of codes1[:cut] + codes2[t:], from the two prefix hash arrays."""
+    n2 = len(prefix2) - 1
+    pw = _POW if len(_POW) > n2 else _powers(n2)
+    tail = prefix2[n2] - prefix2[t] * pw[n2 - t]
+    return (prefix1[cut] * pw[n2 - t] + tail) % HASH_MOD
+
+
+class PairingArena:
+    """
+    Pairings stored back to back in one contiguous code buffer (CSR layout): pairing j is
+    `codes[offsets[j]:offsets[j+1]]` with base id `bases[j]`. Appending never allocates per pairing beyond the
+    shared arrays.
+
+    The arena also works as a bump allocator for candidates: `stage` writes a sequence at the tail of `codes`, past
+    the last committed pairing, and `commit` makes it the next pairing while `rollback` drops it again, so a rejected
+    candidate costs a truncation and an accepted one no object of its own.
+    """
+
+    def __init__(self):
+        self.offsets = array("I", [0])
+        self.codes = array("I")
+        self.bases = array("I")
+
+    def __len__(self):
+        return len(self.bases)
+
+    def append(self, codes, base=0):
+        self.codes.extend(codes)
+        return self.commit(base)
+
+    def stage(self, codes):
+        """Writes `codes` as the pending candidate (appended to whatever is already pending)."""
+        self.codes.extend(codes)
+
+    def rollback(self):
+        """Drops the pending candidate."""
+        del self.codes[self.offsets[-1]:]
+
+    def commit(self, base=0):
+        """Turns the pending candidate into the next pairing; returns its index."""
+        self.offsets.append(len(self.codes))
+        self.bases.append(base)
+        return len(self.bases) - 1
+
+    def __getitem__(self, j):
+        return self.codes[self.offsets[j]:self.offsets[j + 1]]
+
+    def __iter__(self):
+        offsets, codes = self.offsets, self.codes
+        for j in range(len(self.bases)):
+            yield codes[offsets[j]:offsets[j + 1]]
+
+    @property
+    def nnz(self):
+        return len(self.codes)
@@ -0,0 +1,244 @@
+# -*- coding: utf-8 -*-
+"""
+overlapped_pipeline.py
+
+Pipelined Phase 3 -> Phase 2 -> Phase 4 run: generation, cost scoring and the restricted master work at the same
+time instead of one after another through pool files.
+
+    generator   generate_sample_parallel in a thread (its sampling runs in worker processes) with a sink that cuts
+                accepted pairings into batches and pushes them into a bounded queue
+    scorers     threads taking batches off that queue and filling in predicted costs (a Phase 2
+                CompiledCostModel.as_scorer callable; cheap_cost when none is given) before passing them on
+    master      the calling thread adds scored pairings to the solver as columns and re-solves the LP master
+                (_LPMaster, as in column generation) on a background thread every `resolve_every` columns, adding
+                whatever arrived in between before the next re-solve
+
+When the generator finishes, the integer SPP is solved over every column (with HiGHS, continuing from the master's
+last basis) and warm-started from the initial solution. Queues are bounded, so a slow stage throttles the ones
+upstream instead of letting batches pile up, and wall time approaches that of the slowest stage plus the final
+integer solve. Queue traffic is one put/get per batch, so the locks of queue.Queue are taken a few times per thousand
+pairings rather than per pairing.
+
+Usage:
+    python overlapped_pipeline.py path/to/instanceN [target] [time_limit] [backend]
+"""
+
+import queue
+import sys
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+import pipeline_trace as trace
+
+BATCH_SIZE = 512
+QUEUE_BATCHES = 8
+RESOLVE_EVERY = 5000
+
+_DONE = None
+
+
+class QueueSink:
+    """PoolWriter-compatible sink (append(duties, base, cost)) pushing batches of pool dicts into `out`."""
+
+    def __init__(self, out, batch_size=BATCH_SIZE):
+        self.out = out
+        self.batch_size = batch_size
+        self.batch = []
+        self.batches = 0
+
+    def append(self, duties, base, cost):
+        self.batch.append({"base": base, "duties": duties, "cost": cost})
+        if len(self.batch) >= self.batch_size:
+            self.flush()
+
+    def flush(self):
+        if self.batch:
+            self.out.put(self.batch)
+            self.batches += 1
+            self.batch = []
+
+
+class OverlappedPipeline:
+    """
+    Runs generation, scoring and the master concurrently into `solver`, an SPPFromCSV whose legs are loaded
+    (load_legs_csv or load_compiled) and whose pool is replaced by the generated pairings. `scorer` maps a list of
+    pool dicts to costs; `backend` is the SPP backend of the LP master and the final integer solve ("heuristic" has
+    no LP master, so scored columns are only collected). Each generator worker proposes at most `round_quota`
+    pairings per round (default `resolve_every`), which sets how often batches reach the queue.
+    """
+
+    def __init__(self, solver, solution, network=None, scorer=None, backend="pulp", scorers=1,
+                 batch_size=BATCH_SIZE, queue_batches=QUEUE_BATCHES, resolve_every=RESOLVE_EVERY,
+                 round_quota=None, artificial_cost=1e6):
+        self.solver = solver
+        self.solution = solution
+        self.network = network
+        self.scorer = scorer
+        self.backend = backend
+        self.scorers = max(1, scorers)
+        self.batch_size = batch_size
+        self.resolve_every = resolve_every
+        self.round_quota = round_quota or resolve_every
+        self.artificial_cost = artificial_cost
+        self.generated = queue.Queue(maxsize=queue_batches)
+        self.scored = queue.Queue(maxsize=queue_batches)
+        self.errors = []
+        self._lock = threading.Lock()
+        self.history = []            # (seconds since start, columns in master, LP objective) per master re-solve
+        self.timings = {}
+
+    # ------------------------------------------------------------
+    # Stages
+    # ------------------------------------------------------------
+    def _generate(self, target_size, time_limit, mode, seed, workers):
+        from phase_3_set_generation_script import generate_sample_parallel
+
+        sink = QueueSink(self.generated, self.batch_size)
+        try:
+            t0 = time.perf_counter()
+            generate_sample_parallel(self.solution, target_size, time_limit, mode, seed=seed, workers=workers,
+                                     sink=sink, network=self.network, round_quota=self.round_quota)
+            sink.flush()
+            self.timings["generate"] = time.perf_counter() - t0
+        except Exception as e:             # surfaced by run(); the sentinels below still stop the other stages
+            self.errors.append(e)
+        finally:
+            for _ in range(self.scorers):
+                self.generated.put(_DONE)
+
+    def _score(self):
+        from phase_3_set_generation_script import cheap_cost
+
+        score = self.scorer or (lambda batch: [cheap_cost(p["duties"]) for p in batch])
+        busy = 0.0
+        while True:
+            batch = self.generated.get()
+            if batch is _DONE:
+                break
+            if self.errors:
+                continue                   # keep draining so the generator never blocks on a full queue
+            t0 = time.perf_counter()
+            try:
+                for p, cost in zip(batch, score(batch)):
+                    p["cost"] = float(cost)
+            except Exception as e:
+                self.errors.append(e)
+                continue
+            busy += time.perf_counter() - t0
+            self.scored.put(batch)
+        with self._lock:
+            self.timings["score"] = self.timings.get("score", 0.0) + busy
+        self.scored.put(_DONE)
+
+    def _add(self, batch, solver, row_of_code, ready, held):
+        """Appends a scored batch to the solver's pool; columns over known rows also go to `ready` for the master."""
+        for p in batch:
+            codes = solver.leg_dict.encode(p["duties"])
+            j = len(solver.pairings)
+            solver.pairings.append({"pairing_index": j, "pairing_id": str(j), "base": p["base"],
+                                    "legs": p["duties"], "codes": codes})
+            solver.c.append(p["cost"])
+            rows = [row_of_code.get(code) for code in codes]
+            if None in rows:
+                held.append(j)             # leg outside the loaded legs: joins at the final solve, with its new row
+            else:
+                ready.append((sorted(rows), p["cost"]))
+
+    # ------------------------------------------------------------
+    # Driver
+    # ------------------------------------------------------------
+    def run(self, target_size, time_limit, mode="mixed", seed=0, workers=None, solve_time_limit=None):
+        """
+        Generates up to `target_size` pairings for `time_limit` seconds while they are scored and fed to the master,
+        then solves the integer SPP (`solve_time_limit` seconds). Returns the selected pool indices.
+        """
+        from phase_4_set_partitioning_solvers_3 import _LPMaster, SparseIncidence
+
+        solver = self.solver
+        start = time.perf_counter()
+        solver.pairings, solver.c = [], []
+        row_of_code = dict(solver.row_of_code)
+        master = None
+        if self.backend in ("pulp", "highs"):
+            master = _LPMaster(solver.m, [], [], self.artificial_cost, self.backend, solver.cover_rows())
+
+        threads = [threading.Thread(target=self._generate, args=(target_size, time_limit, mode, seed, workers),
+                                    name="generate", daemon=True)]
+        threads += [threading.Thread(target=self._score, name=f"score-{k}", daemon=True)
+                    for k in range(self.scorers)]
+        for t in threads:
+            t.start()
+
+        ready, held = [], []
+        pending = None                 # running master re-solve
+        finished = 0
+        with ThreadPoolExecutor(max_workers=1) as lp, trace.span("overlap.stream"):
+            while finished < self.scorers:
+                batch = self.scored.get()
+                if batch is _DONE:
+                    finished += 1
+                    continue
+                self._add(batch, solver, row_of_code, ready, held)
+                if pending is not None and pending[0].done():
+                    self._record(start, pending)
+                    pending = None
+                if master is not None and pending is None and len(ready) >= self.resolve_every:
+                    master.add_columns(ready)
+                    ready = []
+                    pending = (lp.submit(master.solve), len(master.columns))
+            if pending is not None:
+                self._record(start, pending)
+        for t in threads:
+            t.join()
+        if self.errors:
+            raise self.errors[0]
+        self.timings["stream"] = time.perf_counter() - start
+
+        solver.n = len(solver.pairings)
+        trace.count("overlap.columns", solver.n)
+        print(f"Pipelined {solver.n} pairings in {self.timings['stream']:.2f}s "
+              f"({len(self.history)} master re-solves, {len(held)} pairings over new legs)")
+        reference = [p["duties"] for p in self.solution]
+        if held or master is None:
+            solver.infer_incidence()
+            master = None
+        else:
+            master.add_columns(ready)
+            solver.a = SparseIncidence.from_columns(solver.m, master.columns)
+        use_master = master if self.backend == "highs" else None
+        selected = solver.solve_spp(backend=self.backend, time_limit=solve_time_limit,
+                                    incumbent=solver.find_incumbent(reference), master=use_master)
+        self.timings["total"] = time.perf_counter() - start
+        return selected
+
+    def _record(self, start, pending):
+        future, columns = pending
+        obj, _ = future.result()
+        self.history.append((time.perf_counter() - start, columns, obj))
+        print(f"Master re-solve: {columns} columns, LP objective {obj:.2f}")
+
+
+# ============================================================
+#  COMMAND LINE
+# ============================================================
+if __name__ == "__main__":
+    import os
+    from flight_network import FlightNetwork
+    from instance_store import open_instance
+    from phase_3_set_generation_script import parse_solution
+    from phase_4_set_partitioning_solvers_3 import SPPFromCSV
+
+    folder = sys.argv[1]
+    target = int(sys.argv[2]) if len(sys.argv) > 2 else 50_000
+    limit = float(sys.argv[3]) if len(sys.argv) > 3 else 60.0
+    backend = sys.argv[4] if len(sys.argv) > 4 else "pulp"
+
+    inst = open_instance(folder)
+    spp = SPPFromCSV(folder)
+    spp.load_compiled(inst)
+    pipeline = OverlappedPipeline(spp, parse_solution(os.path.join(folder, "initialSolution.in")),
+                                  network=FlightNetwork(inst, inst.bases), backend=backend)
+    chosen = pipeline.run(target, limit)
+    print(f"Selected {len(chosen)} pairings; timings: "
+          + ", ".join(f"{k} {v:.2f}s" for k, v in pipeline.timings.items()))
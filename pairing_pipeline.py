@@ -0,0 +1,181 @@
+# -*- coding: utf-8 -*-
+"""
+pairing_pipeline.py
+
+One import for the notebooks: the fast path of every stage behind the names the Colab scripts already use, with the
+big arrays handed out through the buffer protocol instead of being copied into lists or DataFrames.
+
+    import pairing_pipeline as pp
+
+    inst = pp.open_instance("/content/sample_data")            # compiled instance.bin, memory-mapped
+    n, _ = pp.generate_pool("/content/sample_data", "sample.pool", target=50_000, time_limit=60)
+    X, labels = pp.pool_features("sample.pool", inst)              # (n, 14) float64 feature matrix
+    solver = pp.load_solver(inst, pool="sample.pool")
+    arrays = pp.as_numpy(pp.incidence_arrays(solver))            # CSC/CSR incidence as NumPy views
+    selected = solver.solve_spp(backend="highs", time_limit=300)
+
+Drop-in names: `SPPFromCSV` (Phase 4), `build_feature_dataframe` (the batch kernel behind the Phase 2 signature,
+build_feature_dataframe_fast) and `generate_sample` (the parallel generator with its keyword extensions:
+workers, sink, scorer, duals, ...), so `from pairing_pipeline import ...` replaces the per-phase imports without
+touching the rest of a notebook.
+
+Everything here is pure Python over `array` buffers; the stage modules are imported on first use, so the module
+loads without NumPy/pandas/sklearn (Phase 2) or PuLP (Phase 4) installed until a function needs them.
+"""
+
+from array import array
+
+from instance_store import compile_instance, open_instance  # noqa: F401  (re-exported)
+
+_LAZY = {
+    "SPPFromCSV": ("phase_4_set_partitioning_solvers_3", "SPPFromCSV"),
+    "build_feature_dataframe": ("phase_2_predict_cost_pipeline", "build_feature_dataframe_fast"),
+    "CompiledCostModel": ("phase_2_predict_cost_pipeline", "CompiledCostModel"),
+    "generate_sample": ("phase_3_set_generation_script", "generate_sample_parallel"),
+    "parse_solution": ("phase_3_set_generation_script", "parse_solution"),
+    "FlightNetwork": ("flight_network", "FlightNetwork"),
+    "OverlappedPipeline": ("overlapped_pipeline", "OverlappedPipeline"),
+}
+
+
+def __getattr__(name):
+    target = _LAZY.get(name)
+    if target is None:
+        raise AttributeError(f"module 'pairing_pipeline' has no attribute {name!r}")
+    import importlib
+    value = getattr(importlib.import_module(target[0]), target[1])
+    globals()[name] = value
+    return value
+
+
+# ============================================================
+#  Generation
+# ============================================================
+def generate_pool(folder, pool_path, target, time_limit, mode="mixed", seed=0, workers=None, legal=True, **kwargs):
+    """
+    Phase 3 pool of `target` pairings for the instance in `folder` (its compiled instance.bin is used, and built if
+    missing), streamed to `pool_path`. `legal` restricts the pool to pairings the flight network accepts; other
+    keyword arguments go to generate_sample_parallel. Returns (pool size, seconds).
+    """
+    import os
+    from flight_network import FlightNetwork
+    from phase_3_set_generation_script import parse_solution, generate_sample_parallel
+    from pool_store import PoolWriter
+
+    solution = parse_solution(os.path.join(folder, "initialSolution.in"))
+    inst = open_instance(folder) if legal else None
+    try:
+        network = FlightNetwork(inst, inst.bases) if inst is not None else None
+        with PoolWriter(pool_path) as sink:
+            return generate_sample_parallel(solution, max(target, len(solution)), time_limit, mode, seed=seed,
+                                            workers=workers, sink=sink, network=network, **kwargs)
+    finally:
+        if inst is not None:
+            inst.close()
+
+
+# ============================================================
+#  Features and scoring
+# ============================================================
+def pool_features(pool_path, instance, n_threads=None):
+    """
+    FEATURE_COLUMNS matrix of a pool file, one stored chunk at a time through the batch kernel, over the leg table
+    of a compiled `instance` (whose leg times are views into the mapped file). Returns (features, base labels);
+    the base column holds codes into the labels, as with pairing_features_batch.
+    """
+    import numpy as np
+    import phase_2_predict_cost_pipeline as p2
+    from pool_store import PoolReader
+
+    table = p2.leg_table_from_compiled(instance)
+    base_col = p2.FEATURE_COLUMNS.index("base")
+    reader = PoolReader(pool_path)
+    parts, labels = [], {}
+    for chunk in reader.chunks():
+        csr = p2.pairings_to_csr(_chunk_pairings(reader, chunk), table, {})
+        features, chunk_labels = p2.pairing_features_batch(csr, table, n_threads=n_threads)
+        remap = np.array([labels.setdefault(label, len(labels)) for label in chunk_labels], dtype=np.float64)
+        features[:, base_col] = remap[features[:, base_col].astype(np.int64)]
+        parts.append(features)
+    if not parts:
+        return np.empty((0, len(p2.FEATURE_COLUMNS)), dtype=np.float64), []
+    return (parts[0] if len(parts) == 1 else np.concatenate(parts)), list(labels)
+
+
+def score_pool(model_path, pool_path, instance, n_threads=None):
+    """Predicted costs (float64 array, pool order) of a pool file under an exported cost model."""
+    import phase_2_predict_cost_pipeline as p2
+
+    model = p2.CompiledCostModel.load(model_path)
+    return model.score_pool(pool_path, None, {}, leg_table=p2.leg_table_from_compiled(instance), n_threads=n_threads)
+
+
+def _chunk_pairings(reader, chunk):
+    return [{"base": reader.bases[chunk.base_ids[k]], "duties": reader.legs.decode(chunk.pairing(k))}
+            for k in range(len(chunk))]
+
+
+# ============================================================
+#  Solver
+# ============================================================
+def load_solver(instance=None, csv_dir=None, pool=None, costs=None):
+    """
+    SPPFromCSV over a compiled `instance` (instance_store) or, without one, the Phase 0 CSVs in `csv_dir`; with
+    `pool` the columns are the pairings of that pool file instead of the initial solution. `costs` (any sequence,
+    e.g. score_pool output) replaces the cost vector.
+    """
+    from phase_4_set_partitioning_solvers_3 import SPPFromCSV
+
+    if instance is not None:
+        import os
+        solver = SPPFromCSV(csv_dir or os.path.dirname(instance.path))
+        solver.load_compiled(instance)
+    else:
+        solver = SPPFromCSV(csv_dir)
+        solver.load_legs_csv()
+        if pool is None:
+            solver.load_pairings_csv()
+            solver.infer_incidence()
+    if pool is not None:
+        solver.load_pool(pool)
+    if costs is not None:
+        solver.c = [float(v) for v in costs]
+    return solver
+
+
+def incidence_arrays(solver):
+    """
+    The solver's incidence and costs as memoryviews: col_ptr/row_idx (CSC: legs of each pairing), row_ptr/col_idx
+    (CSR: pairings of each leg), all uint32 and shared with the solver, plus costs (float64, copied once from the
+    solver's list).
+    """
+    if solver.a is None:
+        solver.infer_incidence()
+    a = solver.a
+    return {
+        "col_ptr": memoryview(a.col_ptr),
+        "row_idx": memoryview(a.row_idx),
+        "row_ptr": memoryview(a.row_ptr),
+        "col_idx": memoryview(a.col_idx),
+        "costs": memoryview(array("d", solver.c)),
+    }
+
+
+def as_numpy(buffers):
+    """NumPy views (no copies) of a dict of buffers such as incidence_arrays() returns."""
+    import numpy as np
+
+    return {name: np.asarray(view) for name, view in buffers.items()}
+
+
+def to_scipy(solver):
+    """
+    scipy.sparse.csc_matrix (m x n) over the solver's incidence arrays: the all-ones data array is new, and scipy
+    copies the uint32 index arrays only if it needs another index type.
+    """
+    import numpy as np
+    from scipy.sparse import csc_matrix
+
+    views = as_numpy(incidence_arrays(solver))
+    data = np.ones(len(views["row_idx"]), dtype=np.float64)
+    return csc_matrix((data, views["row_idx"], views["col_ptr"]), shape=(solver.m, solver.n))
@@ -21,9 +21,52 @@ Usage:
 """
 
 import sys
-import re
 import csv
-from collections import OrderedDict
+import mmap
+
+import pipeline_trace as trace
+
+# Large write buffers: the four CSVs are streamed side by side in one pass,
+# so each file gets its own buffer instead of flushing row by row.
+WRITE_BUFFER_BYTES = 1 << 20
+
+
+def _find_keyword_value(part, keyword):
+    """
+    Locates `keyword` (case-insensitive) followed by at least one whitespace character and returns the index where
+    the value after that whitespace starts, or -1 when the keyword never appears in that form.
+    Plain string scanning replaces the former `re.search` calls, which dominated parse time on large files.
+    """
+    low = part.lower()
+    k = len(keyword)
+    pos = low.find(keyword)
+    while pos != -1:
+        j = pos + k
+        if j < len(part) and part[j].isspace():
+            while j < len(part) and part[j].isspace():
+                j += 1
+            return j
+        pos = low.find(keyword, pos + 1)
+    return -1
+
+
+def _parse_pairing_number(part):
+    r"""Returns the integer after 'Pairing', or None (same match as r'Pairing\s+(\d+)')."""
+    low = part.lower()
+    pos = low.find('pairing')
+    while pos != -1:
+        j = pos + 7
+        if j < len(part) and part[j].isspace():
+            while j < len(part) and part[j].isspace():
+                j += 1
+            k = j
+            while k < len(part) and part[k].isdecimal():
+                k += 1
+            if k > j:
+                return int(part[j:k])
+        pos = low.find('pairing', pos + 1)
+    return None
+
 
 def parse_line(line):
     """
@@ -40,42 +83,53 @@ def parse_line(line):
     # Remove trailing semicolon if present
     if line.endswith(';'):
         line = line[:-1]
-    # Regex for pairing id and base
     # split by ':' to be robust to formatting variations
     parts = [p.strip() for p in line.split(':')]
     # Expect at least 3 parts: "Pairing X", "Base Y", "LEG..., LEG..."
     if len(parts) < 3:
         return ('WARN', line)
     # pairing id from parts[0]
-    m = re.search(r'Pairing\s+(\d+)', parts[0], re.IGNORECASE)
-    if not m:
+    pairing_id = _parse_pairing_number(parts[0])
+    if pairing_id is None:
         return ('WARN', line)
-    pairing_id = int(m.group(1))
     # base from parts[1]
-    m2 = re.search(r'Base\s+(.+)', parts[1], re.IGNORECASE)
-    if not m2:
+    j = _find_keyword_value(parts[1], 'base')
+    if j == -1 or j >= len(parts[1]):
         base = parts[1]
     else:
-        base = m2.group(1).strip()
+        base = parts[1][j:].strip()
     # remaining parts after second colon may contain additional colons; join them
     legs_part = ':'.join(parts[2:]).strip()
-    # split legs by commas
-    raw_tokens = [tok.strip() for tok in legs_part.split(',')]
     # clean tokens: remove empty, remove trailing semicolons (already removed), keep TDH_ prefix
     legs = []
     warnings = []
-    for tok in raw_tokens:
-        if not tok:
-            continue
-        # remove stray trailing characters
+    for tok in legs_part.split(','):
         tok_clean = tok.strip()
+        if not tok_clean:
+            continue
         # if token contains illegal/truncated marker like '$' flag it
-        if '$' in tok_clean or tok_clean.endswith(',') or tok_clean.endswith(';'):
-            warnings.append(f"Truncated or suspicious token '{tok}' in pairing {pairing_id}")
+        if '$' in tok_clean or tok_clean.endswith(';'):
+            warnings.append(f"Truncated or suspicious token '{tok_clean}' in pairing {pairing_id}")
         # some tokens in your paste had stray trailing characters like '$' or ended abruptly
         legs.append(tok_clean)
     return ('OK', pairing_id, base, legs, warnings)
 
+
+def _iter_lines(path):
+    """
+    Yields decoded lines from a memory-mapped view of the file so the whole solution never has to be copied into a
+    Python string at once. Empty files cannot be mapped and simply yield nothing.
+    """
+    with open(path, 'rb') as f:
+        try:
+            mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        except ValueError:
+            return
+        with mm:
+            for raw in iter(mm.readline, b''):
+                yield raw.decode('utf-8')
+
+
 def main(path):
 
     """
@@ -87,60 +141,71 @@ def main(path):
     - sparse incidence mapping (leg ↔ pairing),
     - fully expanded pairing–leg table.
 
-    Warnings are aggregated across the entire file and written separately so imperfect input does not silently corrupt the outputs.
+    Leg IDs are interned into `leg_to_index` while the file is read, and all four CSVs are then written in a single
+    pass over the pairings. Warnings are aggregated across the entire file and written separately so imperfect input
+    does not silently corrupt the outputs.
     """
     pairings = []  # list of (pairing_id, base, legs)
     warnings = []
-    with open(path, 'r', encoding='utf-8') as f:
-        for raw in f:
+    leg_to_index = {}  # leg_id -> zero-based index, in order of first appearance
+    in_order = True
+    last_pid = None
+    parse_span = trace.span("phase0.parse", path=path)
+    with parse_span:
+        for raw in _iter_lines(path):
             r = parse_line(raw)
             if r is None:
                 continue
             if r[0] == 'WARN':
                 warnings.append(f"Unparseable line: {r[1]}")
-            else:
-                _, pid, base, legs, w = r
-                pairings.append((pid, base, legs))
-                warnings.extend(w)
-    # sort pairings by pairing id for deterministic order
-    pairings.sort(key=lambda x: x[0])
-    # build leg dictionary (ordered)
-    leg_to_index = OrderedDict()
-    for i, (pid, base, legs) in enumerate(pairings):
-        for leg in legs:
-            if leg not in leg_to_index:
-                leg_to_index[leg] = len(leg_to_index)  # zero-based index
-
-    # write pairings.csv
-    with open('pairings.csv', 'w', newline='', encoding='utf-8') as f:
-        writer = csv.writer(f)
-        writer.writerow(['pairing_index','pairing_id','base','legs_semicolon'])
-        for p_index, (pid, base, legs) in enumerate(pairings):
-            writer.writerow([p_index, pid, base, ';'.join(legs)])
-
-    # write legs.csv
-    with open('legs.csv', 'w', newline='', encoding='utf-8') as f:
-        writer = csv.writer(f)
-        writer.writerow(['leg_index','leg_id'])
-        for leg_id, idx in leg_to_index.items():
-            writer.writerow([idx, leg_id])
-
-    # write incidence.csv (sparse triples)
-    with open('incidence.csv', 'w', newline='', encoding='utf-8') as f:
-        writer = csv.writer(f)
-        writer.writerow(['leg_index','pairing_index'])  # both zero-based
-        for p_index, (pid, base, legs) in enumerate(pairings):
-            for leg in legs:
-                lidx = leg_to_index[leg]
-                writer.writerow([lidx, p_index])
-
-    # write pairing_legs_expanded.csv
-    with open('pairing_legs_expanded.csv', 'w', newline='', encoding='utf-8') as f:
-        writer = csv.writer(f)
-        writer.writerow(['pairing_index','pairing_id','leg_index','leg_id'])
-        for p_index, (pid, base, legs) in enumerate(pairings):
+                continue
+            _, pid, base, legs, w = r
+            pairings.append((pid, base, legs))
+            warnings.extend(w)
+            if last_pid is not None and pid < last_pid:
+                in_order = False
+            last_pid = pid
+            if in_order:
+                for leg in legs:
+                    if leg not in leg_to_index:
+                        leg_to_index[leg] = len(leg_to_index)
+        parse_span.set(pairings=len(pairings), in_order=in_order)
+    trace.count("phase0.pairings", len(pairings))
+    trace.count("phase0.warnings", len(warnings))
+
+    # pairings are expected in id order; only re-sort (and re-intern) when the file says otherwise
+    if not in_order:
+        pairings.sort(key=lambda x: x[0])
+        leg_to_index = {}
+        for pid, base, legs in pairings:
             for leg in legs:
-                writer.writerow([p_index, pid, leg_to_index[leg], leg])
+                if leg not in leg_to_index:
+                    leg_to_index[leg] = len(leg_to_index)
+
+    trace.count("phase0.legs", len(leg_to_index))
+
+    with trace.span("phase0.write", pairings=len(pairings), legs=len(leg_to_index)):
+        # write legs.csv
+        with open('legs.csv', 'w', newline='', encoding='utf-8', buffering=WRITE_BUFFER_BYTES) as f:
+            writer = csv.writer(f)
+            writer.writerow(['leg_index','leg_id'])
+            writer.writerows((idx, leg_id) for leg_id, idx in leg_to_index.items())
+
+        # write pairings.csv, incidence.csv (sparse triples) and pairing_legs_expanded.csv in one pass
+        with open('pairings.csv', 'w', newline='', encoding='utf-8', buffering=WRITE_BUFFER_BYTES) as fp, \
+             open('incidence.csv', 'w', newline='', encoding='utf-8', buffering=WRITE_BUFFER_BYTES) as fi, \
+             open('pairing_legs_expanded.csv', 'w', newline='', encoding='utf-8', buffering=WRITE_BUFFER_BYTES) as fe:
+            pairings_writer = csv.writer(fp)
+            incidence_writer = csv.writer(fi)
+            expanded_writer = csv.writer(fe)
+            pairings_writer.writerow(['pairing_index','pairing_id','base','legs_semicolon'])
+            incidence_writer.writerow(['leg_index','pairing_index'])  # both zero-based
+            expanded_writer.writerow(['pairing_index','pairing_id','leg_index','leg_id'])
+            for p_index, (pid, base, legs) in enumerate(pairings):
+                pairings_writer.writerow([p_index, pid, base, ';'.join(legs)])
+                lidx = [leg_to_index[leg] for leg in legs]
+                incidence_writer.writerows((li, p_index) for li in lidx)
+                expanded_writer.writerows((p_index, pid, li, leg) for li, leg in zip(lidx, legs))
 
     # warnings
     if warnings:
@@ -1,391 +1,288 @@
 # -*- coding: utf-8 -*-
-"""Phase 1 A schedule_analysis.ipynb
-
-Automatically generated by Colab.
-
-Original file is located at
-    https://colab.research.google.com/drive/1XsiGV5gkAcbfdQjTi9UgA4FvlMFdXVBE
 """
+phase_1_a_schedule_analysis.py
 
-using CSV
-using DataFrames
-using Dates
-using Statistics
+Phase 1: Deterministic Calculation of Flight Times, Duties, and Credits.
 
-"""
-Phase 1: Deterministic Calculation of Flight Times, Duties, and Credits
-Reads day_*.csv files and solution_0 to calculate schedule metrics
-"""
+Python port of the original Julia notebook (Phase 1 A schedule_analysis.ipynb). Instead of re-parsing dates for every
+day_*.csv row into a Dict{String, Float64} and walking solution_0 line by line, the metrics are computed on a compiled
+instance (instance_store.py): flight hours and the day number of every leg are derived once from the mapped leg table,
+and each schedule's `--->` activity chain is already a CSR span of integer activity codes. The per-schedule metrics
+and the per-base aggregates are the same as the Julia version:
 
-# Configuration
-const DATA_DIR = "/content/sample_data/DATA_DIR"  # Change this to your data directory
-const BRIEFING_HOURS = 1.0  # Hours per duty for briefing/debriefing
+    flight_time_hours   sum of the flight times of the schedule's flight legs (LEG_ and PAL_LEG_; TDH_ deadheads,
+                        VACATION, POST_* and AST_* activities do not count)
+    num_duties          number of distinct days (from the LEG_<day>_<n> name) with at least one flight leg
+    briefing_hours      num_duties * BRIEFING_HOURS
+    calculated_credits  flight_time_hours - briefing_hours
+    num_legs            flight legs found in the day files
 
-function parse_time_to_hours(time_str::String)
+The only intended difference: arrivals earlier than departures are pushed to the next day by the shared day-file
+loader, where the Julia code produced negative flight times.
 
-    """
-    Parse time string in format HH:MM to hours as Float64
+The same kernel (`chain_metrics`) scores any CSR of activity chains, e.g. the pairings a Phase 4 solve returns
+(`pairing_metrics`), so the metrics can be recomputed for every candidate solution. Schedules are split over worker
+processes that each map the store themselves, so no leg data is copied between processes.
+"""
 
-    Converts a clock time string into fractional hours for numeric calculations.
-    Assumes valid HH:MM input and deliberately avoids DateTime objects to keep the downstream arithmetic lightweight and predictable.
-    """
-    h, m = split(time_str, ':')
-    return parse(Int, h) + parse(Int, m) / 60.0
-end
+import csv
+import os
+import re
+import sys
+from array import array
+from concurrent.futures import ProcessPoolExecutor
 
+from instance_store import CompiledInstance, open_instance
+from leg_dictionary import LegDictionary, ID_MASK, FLAG_TDH
 
-function calculate_flight_time(date_dep::String, hour_dep::String,
-                               date_arr::String, hour_arr::String)
-    """
-    Calculate flight duration in hours between departure and arrival
-    Handles flights that cross midnight
-    """
-    dep_date = Date(date_dep, "yyyy-mm-dd")
-    arr_date = Date(date_arr, "yyyy-mm-dd")
+# Configuration
+DATA_DIR = "/content/sample_data/DATA_DIR"  # Change this to your data directory
+BRIEFING_HOURS = 1.0  # Hours per duty for briefing/debriefing
+PARALLEL_MIN_CHAINS = 2000  # below this, worker processes cost more than they save
 
-    dep_time = parse_time_to_hours(hour_dep)
-    arr_time = parse_time_to_hours(hour_arr)
+COLUMNS = ["schedule_num", "employee", "base", "flight_time_hours", "num_duties", "briefing_hours",
+           "calculated_credits", "num_legs"]
 
-    # Calculate duration considering day change
-    day_diff = Dates.value(arr_date - dep_date)
-    duration = (day_diff * 24.0) + arr_time - dep_time
 
-    return duration
-end
+def leg_hours(instance):
+    """Flight time in hours of every leg of the instance's leg table."""
+    dep, arr = instance.dep_min, instance.arr_min
+    return array("d", [(arr[k] - dep[k]) / 60.0 for k in range(len(instance))])
 
 
-function load_flight_data(data_dir::String, num_days::Int=31)
+def extract_day_from_leg(leg_name):
     """
-    Load all day_*.csv files into a dictionary
-    Returns: Dict{String, Float64} mapping leg_nb to flight_time_hours
+    Extract day number from leg name (e.g., "LEG_07_23" -> 7); -1 if the name has no day field.
     """
-    println("Loading flight data from day files...")
-    flight_dict = Dict{String, Float64}()
-
-    for day in 1:num_days
-        filename = joinpath(data_dir, "day_$day.csv")
-
-        if !isfile(filename)
-            println("Warning: $filename not found, skipping...")
-            continue
-        end
-
-        # Read CSV with specific column types
-        df = CSV.read(filename, DataFrame,
-             types=Dict(:date_dep=>String, :date_arr=>String,
-                       :hour_dep=>String, :hour_arr=>String),
-             stripwhitespace=true)
-
-        # Calculate flight time for each leg
-        for row in eachrow(df)
-            leg_nb = strip(String(row[Symbol("#leg_nb")]))
-
-            flight_time = calculate_flight_time(
-                row[:date_dep], row[:hour_dep],
-                row[:date_arr], row[:hour_arr]
-            )
-
-            flight_dict[leg_nb] = flight_time
-        end
+    parts = leg_name.split("_")
+    if len(parts) >= 2 and parts[1].isdigit():
+        return int(parts[1])
+    return -1
 
-        println("  Loaded day_$day.csv: $(nrow(df)) legs")
-    end
 
-    println("Total legs loaded: $(length(flight_dict))\n")
-    return flight_dict
-end
+def leg_days(instance):
+    """Day number of every leg of the instance's leg table, parsed once from its name."""
+    return array("i", [extract_day_from_leg(name) for name in instance.ids])
 
 
-function extract_day_from_leg(leg_name::String)
+def chain_metrics(offsets, codes, hours, days, names, first=0, last=None):
     """
-    Extract day number from leg name (e.g., "LEG_07_23" -> 7)
+    Metrics of the activity chains first..last-1 of the CSR (`offsets`, `codes`) over the leg table arrays `hours`
+    and `days`; codes refer to the LegDictionary `names`. Returns (flight_time, num_duties, num_legs, missing), the
+    first three as parallel arrays and `missing` the per-chain count of LEG_ tokens not in the day files.
     """
-    # Handle both LEG and PAL_LEG prefixes
-    leg_clean = startswith(leg_name, "PAL_") ? leg_name[5:end] : leg_name
-
-    parts = split(leg_clean, '_')
-    if length(parts) >= 2
-        return parse(Int, parts[2])
-    end
-    return -1
-end
-
-
-function is_flight_leg(task::String)
+    n_legs = len(hours)
+    last = len(offsets) - 1 if last is None else last
+    flight_time = array("d")
+    num_duties = array("I")
+    num_legs = array("I")
+    missing = array("I")
+    for s in range(first, last):
+        total = 0.0
+        flying_days = set()
+        count = lost = 0
+        for code in codes[offsets[s]:offsets[s + 1]]:
+            if code & FLAG_TDH:
+                continue
+            lid = code & ID_MASK
+            if lid < n_legs:
+                if not names.names[lid].startswith("LEG_"):
+                    continue
+                total += hours[lid]
+                count += 1
+                if days[lid] > 0:
+                    flying_days.add(days[lid])
+            elif names.names[lid].startswith("LEG_"):
+                lost += 1
+        flight_time.append(total)
+        num_duties.append(len(flying_days))
+        num_legs.append(count)
+        missing.append(lost)
+    return flight_time, num_duties, num_legs, missing
+
+
+def _rows(instance, metrics, first, last, numbers, employees, bases):
+    flight_time, num_duties, num_legs, _ = metrics
+    rows = []
+    for k, s in enumerate(range(first, last)):
+        briefing = num_duties[k] * BRIEFING_HOURS
+        rows.append({
+            "schedule_num": numbers[s] if numbers is not None else s + 1,
+            "employee": employees[s] if employees else "",
+            "base": instance.airports[bases[s]],
+            "flight_time_hours": flight_time[k],
+            "num_duties": num_duties[k],
+            "briefing_hours": briefing,
+            # Net credits = flight time - briefing/debriefing
+            # (Note: actual credited hours may include additional credits not captured here)
+            "calculated_credits": flight_time[k] - briefing,
+            "num_legs": num_legs[k],
+        })
+    return rows
+
+
+def _schedule_block_local(instance, first, last):
+    """(rows, missing leg counts) of schedules first..last-1."""
+    metrics = chain_metrics(instance.sched_off, instance.sched_codes, leg_hours(instance), leg_days(instance),
+                            instance.leg_dict, first, last)
+    return (_rows(instance, metrics, first, last, instance.sched_num, instance.employees, instance.sched_base),
+            list(metrics[3]))
+
+
+def _schedule_block(path, first, last):
+    """Worker process: maps the store at `path` itself and scores schedules first..last-1."""
+    with CompiledInstance(path) as instance:
+        return _schedule_block_local(instance, first, last)
+
+
+def schedule_metrics(instance, workers=None):
     """
-    Determine if a task is a flight leg (not vacation, deadhead, etc.)
+    Per-schedule metrics of the instance's solution_0 schedules, in file order (list of dicts with COLUMNS).
+    Large instances are split into contiguous blocks over `workers` processes (default: all cores).
     """
-    task = strip(task)
-
-    # Exclude non-flight tasks
-    if task == "VACATION" ||
-       startswith(task, "POST_") ||
-       startswith(task, "TDH_") ||
-       startswith(task, "AST_")
-        return false
-    end
-
-    # Must be LEG or PAL_LEG
-    return startswith(task, "LEG_") || startswith(task, "PAL_LEG_")
-end
-
-
-function parse_schedule_line(line::String)
+    n = instance.n_schedules
+    workers = max(1, min(workers or os.cpu_count() or 1, n))
+    if workers == 1 or n < PARALLEL_MIN_CHAINS:
+        blocks = [_schedule_block_local(instance, 0, n)]
+    else:
+        bounds = [n * w // workers for w in range(workers + 1)]
+        with ProcessPoolExecutor(max_workers=workers) as executor:
+            blocks = list(executor.map(_schedule_block, [instance.path] * workers, bounds[:-1], bounds[1:]))
+
+    rows = []
+    for block_rows, missing in blocks:
+        for row, lost in zip(block_rows, missing):
+            if lost:
+                print(f"  Schedule {row['schedule_num']}: {lost} missing legs")
+        rows.extend(block_rows)
+    print(f"Processed {len(rows)} schedules\n")
+    return rows
+
+
+def pairing_metrics(instance, pairings):
     """
-    Parse a single schedule line from solution_0
-    Returns: (schedule_num, employee, base, tasks)
+    Metrics of pairing dicts ("legs" or "duties" tokens, "base" name), e.g. the pairings a Phase 4 solve selected,
+    with the schedule columns (schedule_num is the 1-based position in `pairings`, employee is empty).
     """
-    # Format: schedule 1 EMP007 (BASE3) : TASK--->TASK--->...;
-
-    # Extract schedule number
-    m = match(r"schedule (\d+)", line)
-    schedule_num = m !== nothing ? parse(Int, m.captures[1]) : -1
-
-    # Extract employee
-    m = match(r"(EMP\d+)", line)
-    employee = m !== nothing ? m.captures[1] : ""
-
-    # Extract base (inside parentheses)
-    m = match(r"\(([A-Z0-9]+)\)", line)
-    base = m !== nothing ? m.captures[1] : ""
-
-    # Extract tasks (everything after : and before ;)
-    m = match(r":\s*(.+);", line)
-    if m !== nothing
-        tasks_str = m.captures[1]
-        tasks = split(tasks_str, "--->")
-        tasks = [strip(t) for t in tasks]
-    else
-        tasks = String[]
-    end
-
-    return (schedule_num, employee, base, String.(tasks))
-end
-
-
-function analyze_schedule(tasks::Vector{String}, flight_dict::Dict{String, Float64})
+    names = LegDictionary(instance.leg_dict.names)
+    offsets = array("I", [0])
+    codes = array("I")
+    bases = array("I")
+    for p in pairings:
+        codes.extend(names.encode(p["legs"] if "legs" in p else p["duties"]))
+        offsets.append(len(codes))
+        bases.append(instance.airport_index[p["base"]])
+    metrics = chain_metrics(offsets, codes, leg_hours(instance), leg_days(instance), names)
+    return _rows(instance, metrics, 0, len(pairings), None, None, bases)
+
+
+def load_actual_credits(credits_file):
     """
-    Calculate metrics for a single schedule
-    Returns: Dict with flight_time, duties, briefing_credit, net_credits
+    Load actual credited hours from creditedHours file for comparison: {schedule_num: {actual_credits,
+    actual_cost, vacations}}.
     """
-    total_flight_time = 0.0
-    flying_days = Set{Int}()
-    leg_count = 0
-    missing_legs = String[]
-
-    for task in tasks
-        if is_flight_leg(task)
-            # Remove PAL_ prefix if present
-            leg_name = startswith(task, "PAL_") ? task[5:end] : task
-
-            # Get flight time
-            if haskey(flight_dict, leg_name)
-                total_flight_time += flight_dict[leg_name]
-                leg_count += 1
-
-                # Track flying days for duty calculation
-                day = extract_day_from_leg(task)
-                if day > 0
-                    push!(flying_days, day)
-                end
-            else
-                push!(missing_legs, leg_name)
-            end
-        end
-    end
-
-    num_duties = length(flying_days)
-    briefing_credit = num_duties * BRIEFING_HOURS
-
-    # Net credits = flight time - briefing/debriefing
-    # (Note: actual credited hours may include additional credits not captured here)
-    net_credits = total_flight_time - briefing_credit
-
-    return Dict(
-        "flight_time" => total_flight_time,
-        "num_duties" => num_duties,
-        "briefing_credit" => briefing_credit,
-        "net_credits" => net_credits,
-        "leg_count" => leg_count,
-        "missing_legs" => missing_legs
-    )
-end
-
-
-function process_solution(solution_file::String, flight_dict::Dict{String, Float64})
-    """
-    Parse solution_0 file and calculate metrics for all schedules
-    """
-    println("Processing solution file: $solution_file")
-
-    if !isfile(solution_file)
-        error("Solution file not found: $solution_file")
-    end
-
-    results = DataFrame(
-        schedule_num = Int[],
-        employee = String[],
-        base = String[],
-        flight_time_hours = Float64[],
-        num_duties = Int[],
-        briefing_hours = Float64[],
-        calculated_credits = Float64[],
-        num_legs = Int[]
-    )
-
-    content = read(solution_file, String)
-    lines = split(content, '\n')
-
-    for line in lines
-        if occursin("schedule", line) && occursin(":", line)
-            schedule_num, employee, base, tasks = parse_schedule_line(string(line))
-
-            if schedule_num > 0
-                metrics = analyze_schedule(tasks, flight_dict)
-
-                push!(results, (
-                    schedule_num,
-                    employee,
-                    base,
-                    metrics["flight_time"],
-                    metrics["num_duties"],
-                    metrics["briefing_credit"],
-                    metrics["net_credits"],
-                    metrics["leg_count"]
-                ))
-
-                if !isempty(metrics["missing_legs"])
-                    println("  Schedule $schedule_num: $(length(metrics["missing_legs"])) missing legs")
-                end
-            end
-        end
-    end
-
-    println("Processed $(nrow(results)) schedules\n")
-    return results
-end
-
-"""
-Load actual credited hours from creditedHours file for comparison
-"""
-function load_actual_credits(credits_file::String)
-    println("Loading actual credited hours from: $credits_file")
-
-    if !isfile(credits_file)
-        println("Warning: creditedHours file not found")
-        return DataFrame()
-    end
-
-    actual_credits = DataFrame(
-        schedule_num = Int[],
-        actual_credits = Float64[],
-        actual_cost = Float64[],
-        vacations = Int[]
-    )
-
-    content = read(credits_file, String)
-    lines = split(content, '\n')
-
-    current_schedule = -1
-    for line in lines
-        # Extract schedule number
-        m = match(r"Schedule (\d+)", line)
-        if m !== nothing
-            current_schedule = parse(Int, m.captures[1])
-        end
-
-        # Extract credited hours
-        m = match(r"credited hours\s*:\s*([\d.]+)", line)
-        if m !== nothing && current_schedule > 0
-            credits = parse(Float64, m.captures[1])
-            push!(actual_credits, (current_schedule, credits, 0.0, 0))
-        end
-
-        # Extract cost
-        m = match(r"schedule cost\s*:\s*([\d.]+)", line)
-        if m !== nothing && !isempty(actual_credits)
-            actual_credits[end, :actual_cost] = parse(Float64, m.captures[1])
-        end
-
-        # Extract vacations
-        m = match(r"number of vacations:\s*(\d+)", line)
-        if m !== nothing && !isempty(actual_credits)
-            actual_credits[end, :vacations] = parse(Int, m.captures[1])
-        end
-    end
-
-    println("Loaded $(nrow(actual_credits)) schedule credits\n")
-    return actual_credits
-end
-
-"""
-Main analysis function
-"""
-function main()
-    println("="^60)
-    println("CREW SCHEDULE ANALYSIS - PHASE 1")
-    println("Deterministic Calculation of Credits and Flight Times")
-    println("="^60)
-    println()
-
-    # Load flight data
-    flight_dict = load_flight_data(DATA_DIR, 31)
-
-    # Process solution
-    solution_file = joinpath(DATA_DIR, "solution_0.txt")
-    calculated_results = process_solution(solution_file, flight_dict)
-
-    # Load actual credits
-    credits_file = joinpath(DATA_DIR, "creditedHours.txt")
-    actual_credits = load_actual_credits(credits_file)
-
-    # Merge calculated and actual
-    if !isempty(actual_credits)
-        results = leftjoin(calculated_results, actual_credits, on=:schedule_num)
-
-        # Calculate difference
-        results.credit_difference = results.actual_credits .- results.calculated_credits
-
-        println("="^60)
-        println("SUMMARY STATISTICS")
-        println("="^60)
-        println("Total schedules: $(nrow(results))")
-        println("\nFlight Time:")
-        println("  Mean: $(round(mean(results.flight_time_hours), digits=2)) hours")
-        println("  Min:  $(round(minimum(results.flight_time_hours), digits=2)) hours")
-        println("  Max:  $(round(maximum(results.flight_time_hours), digits=2)) hours")
-
-        println("\nDuties:")
-        println("  Mean: $(round(mean(results.num_duties), digits=1))")
-        println("  Min:  $(minimum(results.num_duties))")
-        println("  Max:  $(maximum(results.num_duties))")
-
-        if any(!ismissing, results.actual_credits)
-            println("\nCredits Comparison:")
-            println("  Mean actual:     $(round(mean(skipmissing(results.actual_credits)), digits=2)) hours")
-            println("  Mean calculated: $(round(mean(results.calculated_credits), digits=2)) hours")
-            println("  Mean difference: $(round(mean(skipmissing(results.credit_difference)), digits=2)) hours")
-        end
-
-        println("\nBy Base:")
-        for base in unique(results.base)
-            base_data = filter(row -> row.base == base, results)
-            println("  $base: $(nrow(base_data)) schedules, ",
-                   "$(round(sum(base_data.calculated_credits), digits=1)) total credits")
-        end
-    else
-        results = calculated_results
-    end
+    print(f"Loading actual credited hours from: {credits_file}")
+    if not os.path.isfile(credits_file):
+        print("Warning: creditedHours file not found")
+        return {}
+
+    actual = {}
+    current = None
+    with open(credits_file, "r", encoding="utf-8") as f:
+        for line in f:
+            m = re.search(r"Schedule (\d+)", line)
+            if m:
+                current = int(m.group(1))
+            m = re.search(r"credited hours\s*:\s*([\d.]+)", line)
+            if m and current is not None:
+                actual[current] = {"actual_credits": float(m.group(1)), "actual_cost": 0.0, "vacations": 0}
+            m = re.search(r"schedule cost\s*:\s*([\d.]+)", line)
+            if m and current in actual:
+                actual[current]["actual_cost"] = float(m.group(1))
+            m = re.search(r"number of vacations:\s*(\d+)", line)
+            if m and current in actual:
+                actual[current]["vacations"] = int(m.group(1))
+
+    print(f"Loaded {len(actual)} schedule credits\n")
+    return actual
+
+
+def base_aggregates(rows):
+    """{base: (schedules, total calculated credits)} in order of first appearance."""
+    out = {}
+    for row in rows:
+        n, total = out.get(row["base"], (0, 0.0))
+        out[row["base"]] = (n + 1, total + row["calculated_credits"])
+    return out
+
+
+def _mean(values):
+    return sum(values) / len(values) if values else float("nan")
+
+
+def main(data_dir=DATA_DIR, output_file="schedule_analysis_phase1.csv", workers=None):
+    """Main analysis function."""
+    print("=" * 60)
+    print("CREW SCHEDULE ANALYSIS - PHASE 1")
+    print("Deterministic Calculation of Credits and Flight Times")
+    print("=" * 60)
+    print()
+
+    with open_instance(data_dir) as instance:
+        results = schedule_metrics(instance, workers)
+
+    credits_file = os.path.join(data_dir, "creditedHours")
+    if not os.path.isfile(credits_file):
+        credits_file += ".txt"
+    actual = load_actual_credits(credits_file)
+    columns = list(COLUMNS)
+
+    if actual:
+        columns += ["actual_credits", "actual_cost", "vacations", "credit_difference"]
+        for row in results:
+            a = actual.get(row["schedule_num"])
+            row.update(a or {"actual_credits": None, "actual_cost": None, "vacations": None})
+            row["credit_difference"] = a["actual_credits"] - row["calculated_credits"] if a else None
+
+        flight = [r["flight_time_hours"] for r in results]
+        duties = [r["num_duties"] for r in results]
+        print("=" * 60)
+        print("SUMMARY STATISTICS")
+        print("=" * 60)
+        print(f"Total schedules: {len(results)}")
+        print("\nFlight Time:")
+        print(f"  Mean: {round(_mean(flight), 2)} hours")
+        print(f"  Min:  {round(min(flight), 2)} hours")
+        print(f"  Max:  {round(max(flight), 2)} hours")
+
+        print("\nDuties:")
+        print(f"  Mean: {round(_mean(duties), 1)}")
+        print(f"  Min:  {min(duties)}")
+        print(f"  Max:  {max(duties)}")
+
+        matched = [r for r in results if r["actual_credits"] is not None]
+        if matched:
+            print("\nCredits Comparison:")
+            print(f"  Mean actual:     {round(_mean([r['actual_credits'] for r in matched]), 2)} hours")
+            print(f"  Mean calculated: {round(_mean([r['calculated_credits'] for r in results]), 2)} hours")
+            print(f"  Mean difference: {round(_mean([r['credit_difference'] for r in matched]), 2)} hours")
+
+        print("\nBy Base:")
+        for base, (n, total) in base_aggregates(results).items():
+            print(f"  {base}: {n} schedules, {round(total, 1)} total credits")
 
     # Save results
-    output_file = "schedule_analysis_phase1.csv"
-    CSV.write(output_file, results)
-    println("\n" * "="^60)
-    println("Results saved to: $output_file")
-    println("="^60)
+    with open(output_file, "w", newline="", encoding="utf-8") as f:
+        writer = csv.DictWriter(f, fieldnames=columns)
+        writer.writeheader()
+        writer.writerows(results)
+    print("\n" + "=" * 60)
+    print(f"Results saved to: {output_file}")
+    print("=" * 60)
 
     return results
-end
 
-# Run the analysis
-results = main()
+
+if __name__ == "__main__":
+    # Run the analysis
+    results = main(sys.argv[1] if len(sys.argv) > 1 else DATA_DIR)
@@ -225,22 +225,13 @@ def parse_pairings_from_file(pairings_file, schedule_dict, solution_id=0):
     )
 
     matches = pairing_pattern.findall(content)
+    schedule_index = ScheduleIndex(schedule_dict, prefixes=('LEG_', 'PAL_', 'TDH_'))
 
     for pairing_id, base, duties_str in matches:
         duties = [d.strip() for d in duties_str.split('--->')]
 
         # Try to infer schedule by matching overlap with schedule activities
-        matched_schedule = None
-        duty_set = set(duties)
-
-        for sched_id, sched in schedule_dict.items():
-            sched_acts = set(
-                a for a in sched['activities']
-                if a.startswith('LEG_') or a.startswith('PAL_') or a.startswith('TDH_')
-            )
-            if duty_set.issubset(sched_acts):
-                matched_schedule = sched_id
-                break
+        matched_schedule = schedule_index.match(duties)
 
         pairings.append({
             'id': int(pairing_id),
@@ -897,6 +888,8 @@ Or in Colab/Jupyter:
 import pandas as pd
 import numpy as np
 import os
+import json
+from concurrent.futures import ThreadPoolExecutor
 from datetime import datetime, timedelta
 from sklearn.linear_model import Ridge
 from sklearn.preprocessing import OneHotEncoder, PolynomialFeatures
@@ -904,6 +897,9 @@ from sklearn.model_selection import LeaveOneGroupOut
 from sklearn.metrics import mean_squared_error, mean_absolute_error, r2_score
 import re
 import warnings
+
+import pipeline_trace as trace
+
 warnings.filterwarnings('ignore')
 
 # -------------------------------
@@ -1101,19 +1097,49 @@ def parse_pairings_from_file(pairings_file, schedule_dict=None):
         print(f"Error parsing pairings: {e}")
         return []
 
+class ScheduleIndex:
+    """
+    Inverted index from leg token to the schedules containing it, built once per schedule_dict.
+
+    `match(legs)` returns the first schedule (in schedule_dict order) whose leg activities include every leg of the
+    pairing, i.e. the same answer as scanning schedule_dict with issubset, but it only walks the posting list of the
+    pairing's rarest leg and checks those candidates against the precomputed schedule leg sets.
+    """
+
+    def __init__(self, schedule_dict, prefixes=('LEG_', 'PAL_LEG_', 'TDH_')):
+        self.schedule_ids = list(schedule_dict.keys())
+        self.leg_sets = []
+        self.postings = {}           # leg token -> schedule ordinals, ascending
+        for k, schedule_id in enumerate(self.schedule_ids):
+            legs = {act for act in schedule_dict[schedule_id]['activities'] if act.startswith(prefixes)}
+            self.leg_sets.append(legs)
+            for leg in legs:
+                self.postings.setdefault(leg, []).append(k)
+
+    def match(self, legs):
+        legs = set(legs)
+        if not legs:
+            return self.schedule_ids[0] if self.schedule_ids else None
+        rarest = None
+        for leg in legs:
+            posting = self.postings.get(leg)
+            if posting is None:
+                return None
+            if rarest is None or len(posting) < len(rarest):
+                rarest = posting
+        for k in rarest:
+            if legs <= self.leg_sets[k]:
+                return self.schedule_ids[k]
+        return None
+
+
 def link_pairings_to_schedules(pairings, schedule_dict):
     """Try to link pairings to schedules by matching leg sequences."""
+    index = ScheduleIndex(schedule_dict)
     for pairing in pairings:
-        pairing_legs = set(pairing['duties'])
-
-        for schedule_id, schedule_data in schedule_dict.items():
-            schedule_legs = set([act for act in schedule_data['activities']
-                                if act.startswith('LEG_') or act.startswith('PAL_LEG_') or act.startswith('TDH_')])
-
-            # If pairing legs are subset of schedule legs, link them
-            if pairing_legs.issubset(schedule_legs):
-                pairing['schedule'] = schedule_id
-                break
+        schedule_id = index.match(pairing['duties'])
+        if schedule_id is not None:
+            pairing['schedule'] = schedule_id
 
 # -------------------------------
 # 4. Extract pairing-level features
@@ -1229,6 +1255,195 @@ def build_feature_dataframe(pairings, leg_dict, schedule_dict):
     print(f"Built feature matrix: {X.shape[0]} samples, {X.shape[1]} features")
     return X, y, groups
 
+# -------------------------------
+# 5b. Batch feature kernel
+# -------------------------------
+
+FEATURE_COLUMNS = ['n_duties', 'n_deadheads', 'total_duration', 'max_duration', 'min_duration',
+                   'avg_gap', 'max_gap', 'multi_day_flag', 'first_hour', 'last_hour',
+                   'base', 'schedule_hours', 'schedule_cost', 'schedule_vacations']
+FLOAT_FEATURES = {'total_duration', 'max_duration', 'min_duration', 'avg_gap', 'max_gap'}
+FEATURE_CHUNK = 65536
+_EPOCH = pd.Timestamp('1970-01-01')
+
+
+def leg_table_from_dict(leg_dict):
+    """
+    Columnar leg table (NumPy arrays, epoch minutes) built from parse_leg_files output, so the batch kernel can
+    gather leg attributes by integer position instead of looking up dicts per duty.
+    """
+    ids = list(leg_dict.keys())
+    dep = np.array([(leg_dict[l]['dep_dt'] - _EPOCH) // pd.Timedelta(minutes=1) for l in ids], dtype=np.int64)
+    arr = np.array([(leg_dict[l]['arr_dt'] - _EPOCH) // pd.Timedelta(minutes=1) for l in ids], dtype=np.int64)
+    return {
+        'index': {l: i for i, l in enumerate(ids)},
+        'dep_min': dep,
+        'arr_min': arr,
+        'duration_min': np.array([leg_dict[l]['duration_min'] for l in ids], dtype=np.float64),
+    }
+
+
+def leg_table_from_compiled(instance):
+    """Same columnar table over an instance_store.CompiledInstance; dep/arr arrays are views into the mapped file."""
+    dep = np.frombuffer(instance.dep_min, dtype=np.int32)
+    arr = np.frombuffer(instance.arr_min, dtype=np.int32)
+    return {
+        'index': instance.index,
+        'dep_min': dep,
+        'arr_min': arr,
+        'duration_min': (arr - dep).astype(np.float64),
+    }
+
+
+@trace.traced("features.pairings_to_csr")
+def pairings_to_csr(pairings, leg_table, schedule_dict):
+    """
+    Flattens pairings into the CSR arrays the batch kernel reads: `offsets`/`legs` (leg-table positions of the valid
+    duties, after the same PAL_/TDH_ prefix cleaning as pairing_to_features), plus per-pairing raw duty counts,
+    deadhead counts, base labels and linked-schedule attributes. Each distinct duty token is cleaned and resolved once.
+    """
+    index = leg_table['index']
+    resolved = {}
+    offsets = np.zeros(len(pairings) + 1, dtype=np.int64)
+    legs = []
+    n_raw = np.zeros(len(pairings), dtype=np.int64)
+    n_deadheads = np.zeros(len(pairings), dtype=np.int64)
+    sched_hours = np.zeros(len(pairings), dtype=np.int64)
+    sched_vac = np.zeros(len(pairings), dtype=np.int64)
+    bases = []
+
+    for j, pairing in enumerate(pairings):
+        duties = pairing['duties']
+        for d in duties:
+            pos = resolved.get(d)
+            if pos is None:
+                clean_id = d.replace('PAL_LEG_', 'LEG_').replace('TDH_LEG_', 'LEG_').replace('TDH_AGR_', 'LEG_')
+                pos = resolved[d] = index.get(clean_id, -1)
+            if pos >= 0:
+                legs.append(pos)
+        offsets[j + 1] = len(legs)
+        n_raw[j] = len(duties)
+        n_deadheads[j] = sum(1 for d in duties if d.startswith('PAL_') or d.startswith('TDH_'))
+        bases.append(pairing['base'])
+        schedule_id = pairing.get('schedule')
+        schedule_info = schedule_dict.get(schedule_id, {}) if schedule_id else {}
+        sched_hours[j] = schedule_info.get('n_activities', 0)
+        sched_vac[j] = schedule_info.get('n_vacations', 0)
+
+    return {
+        'offsets': offsets,
+        'legs': np.array(legs, dtype=np.int64),
+        'n_raw': n_raw,
+        'n_deadheads': n_deadheads,
+        'bases': bases,
+        'schedule_hours': sched_hours,
+        'schedule_vacations': sched_vac,
+    }
+
+
+def _features_chunk(csr, leg_table, base_codes, rows, a, b):
+    """
+    Fills `rows` (the b-a feature rows of pairings a..b-1) with segmented reductions over the chunk's flattened legs. Legs are sorted by
+    departure inside each pairing (stable, like sorted() on dep_dt), gaps are taken between consecutive sorted legs
+    of the same pairing, and every per-pairing statistic is one ufunc.reduceat over the segment starts.
+    """
+    offsets = csr['offsets'][a:b + 1]
+    lengths = np.diff(offsets)
+    legs = csr['legs'][offsets[0]:offsets[-1]]
+    k = b - a
+    seg = np.repeat(np.arange(k), lengths)
+
+    dep = leg_table['dep_min'][legs].astype(np.int64)
+    arr = leg_table['arr_min'][legs].astype(np.int64)
+    dur = leg_table['duration_min'][legs]
+    order = np.lexsort((dep, seg))
+    dep_s, arr_s = dep[order], arr[order]
+
+    rows[:] = 0
+    rows[:, 0] = csr['n_raw'][a:b]                    # n_duties for pairings without valid legs
+    rows[:, 10] = base_codes[a:b]
+
+    has = lengths > 0
+    if has.any():
+        starts = (offsets[:-1] - offsets[0])[has]
+        ends = starts + lengths[has] - 1
+        rows[has, 0] = lengths[has]
+        rows[has, 1] = csr['n_deadheads'][a:b][has]
+        rows[has, 2] = np.add.reduceat(dur, starts)
+        rows[has, 3] = np.maximum.reduceat(dur, starts)
+        rows[has, 4] = np.minimum.reduceat(dur, starts)
+        day = dep_s // 1440
+        rows[has, 7] = (np.maximum.reduceat(day, starts) != np.minimum.reduceat(day, starts))
+        rows[has, 8] = (dep_s[starts] // 60) % 24
+        rows[has, 9] = (arr_s[ends] // 60) % 24
+        rows[has, 11] = csr['schedule_hours'][a:b][has]
+        rows[has, 13] = csr['schedule_vacations'][a:b][has]
+
+        multi = lengths > 1
+        if multi.any():
+            gaps = np.maximum(dep_s[1:] - arr_s[:-1], 0).astype(np.float64)
+            gaps[seg[order][1:] != seg[order][:-1]] = 0.0   # pairs straddling two pairings
+            gstarts = (offsets[:-1] - offsets[0])[multi]
+            rows[multi, 5] = np.add.reduceat(gaps, gstarts) / (lengths[multi] - 1)
+            rows[multi, 6] = np.maximum.reduceat(gaps, gstarts)
+
+
+@trace.traced("features.batch")
+def pairing_features_batch(csr, leg_table, out=None, n_threads=None):
+    """
+    Batch replacement for calling pairing_to_features per pairing. Writes the FEATURE_COLUMNS matrix straight into
+    a preallocated float64 buffer (`out`, shape (n, 14)); the base column holds integer codes into the returned
+    list of base labels. Chunks of FEATURE_CHUNK pairings are processed on a thread pool (NumPy releases the GIL
+    inside the reductions).
+    """
+    n = len(csr['offsets']) - 1
+    if out is None:
+        out = np.empty((n, len(FEATURE_COLUMNS)), dtype=np.float64)
+    base_labels, base_codes = _base_codes(csr)
+
+    def run(ab):
+        a, b = ab
+        _features_chunk(csr, leg_table, base_codes, out[a:b], a, b)
+
+    with ThreadPoolExecutor(max_workers=n_threads or os.cpu_count()) as pool:
+        list(pool.map(run, _chunks(n)))
+    trace.count("features.rows", n)
+    return out, list(base_labels)
+
+
+def _base_codes(csr):
+    return np.unique(np.array(csr['bases'], dtype=object).astype(str), return_inverse=True)
+
+
+def _chunks(n):
+    return [(a, min(a + FEATURE_CHUNK, n)) for a in range(0, n, FEATURE_CHUNK)]
+
+
+def features_to_dataframe(features, base_labels):
+    """DataFrame view of a batch feature matrix with the same columns and base labels as build_feature_dataframe."""
+    X = pd.DataFrame(features, columns=FEATURE_COLUMNS)
+    for col in FEATURE_COLUMNS:
+        if col not in FLOAT_FEATURES and col != 'base':
+            X[col] = X[col].astype(np.int64)
+    X['base'] = np.array(base_labels, dtype=object)[features[:, 10].astype(np.int64)]
+    return X
+
+
+def build_feature_dataframe_fast(pairings, leg_dict, schedule_dict, leg_table=None, n_threads=None):
+    """
+    Drop-in for build_feature_dataframe on large pools: flattens the pairings once, runs the batch kernel and wraps
+    the result. Pass a prebuilt `leg_table` (leg_table_from_dict / leg_table_from_compiled) to reuse it across calls.
+    """
+    if leg_table is None:
+        leg_table = leg_table_from_dict(leg_dict)
+    csr = pairings_to_csr(pairings, leg_table, schedule_dict)
+    features, base_labels = pairing_features_batch(csr, leg_table, n_threads=n_threads)
+    X = features_to_dataframe(features, base_labels)
+    y = np.array([p.get('cost', 0) for p in pairings])
+    groups = np.array([p.get('solution_id', 0) for p in pairings])
+    print(f"Built feature matrix: {X.shape[0]} samples, {X.shape[1]} features")
+    return X, y, groups
+
 # -------------------------------
 # 6. Train model with cross-validation
 # -------------------------------
@@ -1288,6 +1503,175 @@ def train_and_cv(X, y, groups, degree=2, alpha=1.0):
 
     return final_model, poly_transformer, ohe, numeric_cols, categorical_cols
 
+# -------------------------------
+# 6b. Cross-validation sweep
+# -------------------------------
+
+CV_NUMERIC_COLS = ['n_duties', 'n_deadheads', 'total_duration', 'max_duration', 'min_duration',
+                   'avg_gap', 'max_gap', 'first_hour', 'last_hour', 'schedule_hours',
+                   'schedule_cost', 'schedule_vacations']
+CV_CATEGORICAL_COLS = ['base', 'multi_day_flag']
+CV_ALPHAS = np.logspace(-3, 3, 13)
+
+
+def design_matrix(X, degree, numeric_cols=CV_NUMERIC_COLS, categorical_cols=CV_CATEGORICAL_COLS):
+    """The train_and_cv design matrix (polynomial numeric block + one-hot block) with its fitted transformers."""
+    poly = PolynomialFeatures(degree=degree, include_bias=False)
+    ohe = OneHotEncoder(sparse_output=False, handle_unknown='ignore')
+    X_final = np.hstack([poly.fit_transform(X[numeric_cols].values), ohe.fit_transform(X[categorical_cols])])
+    return X_final, poly, ohe
+
+
+class GroupGram:
+    """
+    Per-group sufficient statistics of a design matrix: row count, column means, y mean, and the centred scatter
+    matrices (X - mean)'(X - mean) and (X - mean)'(y - y mean) of every group (in LeaveOneGroupOut order). The
+    centred training Gram matrix of any leave-one-group-out fold is then the sum of the other groups' scatter
+    matrices plus the spread of their means (parallel-axis formula), with no pass over the data. Centring inside
+    each group keeps the large raw moments of degree-2 columns out of the subtraction, so the result matches
+    centring the training rows directly.
+    """
+
+    def __init__(self, X_final, y, groups):
+        groups = np.asarray(groups)
+        self.X = X_final
+        self.y = y
+        self.labels = np.unique(groups)
+        self.rows = [np.flatnonzero(groups == g) for g in self.labels]
+        self.n = np.array([len(r) for r in self.rows], dtype=np.float64)
+        self.mx = np.stack([X_final[r].mean(axis=0) for r in self.rows])
+        self.my = np.array([y[r].mean() for r in self.rows])
+        self.sxx = np.empty((len(self.rows), X_final.shape[1], X_final.shape[1]))
+        self.sxy = np.empty((len(self.rows), X_final.shape[1]))
+        for g, r in enumerate(self.rows):
+            xc = X_final[r] - self.mx[g]
+            self.sxx[g] = xc.T @ xc
+            self.sxy[g] = xc.T @ (y[r] - self.my[g])
+
+    def training_gram(self, k):
+        """(n, column means, y mean, centred X'X, centred X'y) of the rows outside group k."""
+        keep = np.arange(len(self.rows)) != k
+        n_g, mx, my = self.n[keep], self.mx[keep], self.my[keep]
+        n = n_g.sum()
+        mu = n_g @ mx / n
+        y_mean = n_g @ my / n
+        dx = mx - mu
+        gram = self.sxx[keep].sum(axis=0) + dx.T @ (n_g[:, None] * dx)
+        rhs = self.sxy[keep].sum(axis=0) + dx.T @ (n_g * (my - y_mean))
+        return n, mu, y_mean, gram, rhs
+
+    def fold(self, k, alphas):
+        """
+        Ridge (with unpenalized intercept, like sklearn's Ridge) trained without group k for every alpha at once:
+        one eigendecomposition of the centered training Gram matrix, then a diagonal solve per alpha. Returns the
+        predictions on group k, shape (rows of k, len(alphas)).
+        """
+        _, mu, y_mean, gram, rhs = self.training_gram(k)
+        lam, vecs = np.linalg.eigh(gram)
+        # the Gram matrix is PSD; eigenvalues below zero past rounding mean the statistics are broken
+        floor = -1e-9 * max(abs(lam).max(), 1.0)
+        if lam.min() < floor:
+            print(f"Warning: fold {self.labels[k]} Gram matrix has eigenvalue {lam.min():.3g} "
+                  f"(largest {lam.max():.3g}); predictions for this fold are unreliable")
+        lam = np.where(lam < 0.0, 0.0, lam)   # rounding noise on a singular Gram matrix
+        coef = vecs @ ((vecs.T @ rhs)[:, None] / (lam[:, None] + np.asarray(alphas)[None, :]))
+        intercept = y_mean - mu @ coef
+        return self.X[self.rows[k]] @ coef + intercept
+
+
+def _fold_scores(y_test, pred):
+    """MSE, MAE and R^2 per alpha column of `pred`."""
+    err = pred - y_test[:, None]
+    mse = np.mean(err ** 2, axis=0)
+    mae = np.mean(np.abs(err), axis=0)
+    ss_tot = np.sum((y_test - y_test.mean()) ** 2)
+    r2 = 1.0 - np.sum(err ** 2, axis=0) / ss_tot if ss_tot > 0 else np.full(err.shape[1], np.nan)
+    return mse, mae, r2
+
+
+def cv_sweep(X, y, groups, degrees=(1, 2), alphas=CV_ALPHAS, n_threads=None):
+    """
+    Leave-one-group-out CV of the train_and_cv model over a degree x alpha grid. Each degree's design matrix and
+    per-group Gram matrices are built once; each fold solves the whole alpha grid through one eigendecomposition.
+    Degrees, then (degree, fold) pairs, run on a thread pool (numpy releases the GIL in the heavy kernels).
+
+    Returns a list of {'degree', 'alpha', 'mse', 'mse_std', 'mae', 'mae_std', 'r2', 'r2_std'} dicts sorted by mean
+    MSE (best first), or None when there are fewer than two groups.
+    """
+    y = np.asarray(y, dtype=np.float64)
+    alphas = np.asarray(alphas, dtype=np.float64)
+    if len(np.unique(np.asarray(groups))) < 2:
+        print("Note: Only one group found, skipping cross-validation sweep")
+        return None
+
+    start = datetime.now()
+    with ThreadPoolExecutor(max_workers=n_threads or os.cpu_count()) as pool:
+        grams = list(pool.map(lambda d: GroupGram(design_matrix(X, d)[0], y, groups), degrees))
+        tasks = [(d, k) for d in range(len(degrees)) for k in range(len(grams[d].labels))]
+        scores = list(pool.map(
+            lambda t: _fold_scores(y[grams[t[0]].rows[t[1]]], grams[t[0]].fold(t[1], alphas)), tasks))
+
+    results = []
+    for d, degree in enumerate(degrees):
+        folds = [s for (dd, _), s in zip(tasks, scores) if dd == d]
+        mse, mae, r2 = (np.stack([f[i] for f in folds]) for i in range(3))
+        for a, alpha in enumerate(alphas):
+            results.append({
+                'degree': degree, 'alpha': float(alpha),
+                'mse': float(mse[:, a].mean()), 'mse_std': float(mse[:, a].std()),
+                'mae': float(mae[:, a].mean()), 'mae_std': float(mae[:, a].std()),
+                'r2': float(np.nanmean(r2[:, a])), 'r2_std': float(np.nanstd(r2[:, a])),
+            })
+    results.sort(key=lambda r: r['mse'])
+
+    print(f"\nCV sweep: {len(degrees)} degrees x {len(alphas)} alphas x {len(grams[0].labels)} folds "
+          f"in {(datetime.now() - start).total_seconds():.2f}s")
+    for r in results[:5]:
+        print(f"  degree={r['degree']} alpha={r['alpha']:.4g}: MSE {r['mse']:.2f} ± {r['mse_std']:.2f}, "
+              f"MAE {r['mae']:.2f}, R² {r['r2']:.3f}")
+    return results
+
+
+def check_cv_sweep(n_groups=5, rows_per_group=60, degrees=(1, 2), alphas=(0.01, 1.0, 100.0), seed=0, rtol=1e-6):
+    """
+    Checks the GroupGram folds against the reference loop of train_and_cv (LeaveOneGroupOut + Ridge(alpha) on the
+    same design matrix) on a small synthetic feature frame whose columns are on the scales of the real features
+    (so degree-2 columns reach ~1e7). Per-fold MSE, MAE and R^2 must agree to `rtol` for every degree and alpha.
+    Returns the largest relative difference seen; raises AssertionError on a mismatch.
+    """
+    rng = np.random.default_rng(seed)
+    n = n_groups * rows_per_group
+    X = pd.DataFrame({
+        'n_duties': rng.integers(1, 6, n), 'n_deadheads': rng.integers(0, 3, n),
+        'total_duration': rng.uniform(300, 3000, n), 'max_duration': rng.uniform(100, 800, n),
+        'min_duration': rng.uniform(30, 300, n), 'avg_gap': rng.uniform(30, 600, n),
+        'max_gap': rng.uniform(60, 1200, n), 'first_hour': rng.integers(0, 24, n),
+        'last_hour': rng.integers(0, 24, n), 'schedule_hours': rng.uniform(50, 200, n),
+        'schedule_cost': rng.uniform(1e3, 5e4, n), 'schedule_vacations': rng.integers(0, 4, n),
+        'base': rng.choice(['BASE1', 'BASE2', 'BASE3'], n), 'multi_day_flag': rng.integers(0, 2, n),
+    })
+    y = 2000 + 3.0 * X['total_duration'].values + 0.5 * X['schedule_cost'].values + rng.normal(0, 200, n)
+    groups = np.repeat(np.arange(n_groups), rows_per_group)
+
+    worst = 0.0
+    for degree in degrees:
+        X_final = design_matrix(X, degree)[0]
+        gram = GroupGram(X_final, y, groups)
+        for k, (train_idx, test_idx) in enumerate(LeaveOneGroupOut().split(X_final, y, groups)):
+            fast = _fold_scores(y[test_idx], gram.fold(k, alphas))
+            for a, alpha in enumerate(alphas):
+                pred = Ridge(alpha=alpha).fit(X_final[train_idx], y[train_idx]).predict(X_final[test_idx])
+                ref = (mean_squared_error(y[test_idx], pred), mean_absolute_error(y[test_idx], pred),
+                       r2_score(y[test_idx], pred))
+                for name, got, want in zip(("MSE", "MAE", "R2"), (f[a] for f in fast), ref):
+                    diff = abs(got - want) / max(abs(want), 1e-12)
+                    worst = max(worst, diff)
+                    assert diff <= rtol, (f"degree={degree} fold={k} alpha={alpha}: {name} {got!r} "
+                                          f"vs LeaveOneGroupOut+Ridge {want!r}")
+    print(f"cv_sweep folds match LeaveOneGroupOut + Ridge (degrees {tuple(degrees)}, "
+          f"max relative difference {worst:.2e})")
+    return worst
+
 # -------------------------------
 # 7. Predict costs for pairings
 # -------------------------------
@@ -1310,13 +1694,173 @@ def predict_costs(model, poly_transformer, ohe, numeric_cols, categorical_cols,
 
     return pairings
 
+# -------------------------------
+# 7b. Compiled cost model
+# -------------------------------
+
+COST_MODEL_VERSION = 1
+
+
+def export_cost_model(model, poly_transformer, ohe, numeric_cols, categorical_cols, path=None):
+    """
+    Folds the fitted PolynomialFeatures + OneHotEncoder + Ridge from train_and_cv into plain coefficients:
+    an intercept, one linear weight per numeric column, an upper-triangular matrix of pairwise (degree-2) weights,
+    and one weight per category of every one-hot column. Only degree <= 2 is supported. Writes the coefficients as
+    JSON when `path` is given and returns them as a dict.
+    """
+    powers = poly_transformer.powers_
+    if powers.sum(axis=1).max() > 2:
+        raise ValueError("export_cost_model supports polynomial degree <= 2 only")
+
+    coef = np.asarray(model.coef_, dtype=np.float64).ravel()
+    k = len(numeric_cols)
+    linear = np.zeros(k)
+    quad = np.zeros((k, k))
+    for w, row in zip(coef[:len(powers)], powers):
+        idx = np.flatnonzero(row)
+        if len(idx) == 1 and row[idx[0]] == 1:
+            linear[idx[0]] += w
+        elif len(idx) == 1:
+            quad[idx[0], idx[0]] += w
+        else:
+            quad[idx[0], idx[1]] += w
+
+    categorical = {}
+    pos = len(powers)
+    for col, cats in zip(categorical_cols, ohe.categories_):
+        categorical[col] = [[c.item() if hasattr(c, 'item') else c, float(coef[pos + i])] for i, c in enumerate(cats)]
+        pos += len(cats)
+
+    spec = {
+        'version': COST_MODEL_VERSION,
+        'intercept': float(np.asarray(model.intercept_).ravel()[0]),
+        'numeric': list(numeric_cols),
+        'linear': linear.tolist(),
+        'quadratic': quad.tolist(),
+        'categorical': categorical,
+    }
+    if path:
+        with open(path, 'w') as f:
+            json.dump(spec, f)
+        print(f"Exported cost model to {path}")
+    return spec
+
+
+class CompiledCostModel:
+    """
+    Scorer for an exported cost model. Evaluates intercept + x.w + x'Qx plus the one-hot lookups directly on the
+    FEATURE_COLUMNS matrix, so the ~90 polynomial columns of the training pipeline are never materialized. Categories
+    unseen at training time score 0, like handle_unknown='ignore'.
+    """
+
+    def __init__(self, spec):
+        if spec.get('version') != COST_MODEL_VERSION:
+            raise ValueError(f"Cost model version {spec.get('version')}, expected {COST_MODEL_VERSION}")
+        self.intercept = spec['intercept']
+        self.numeric_idx = np.array([FEATURE_COLUMNS.index(c) for c in spec['numeric']])
+        self.linear = np.array(spec['linear'])
+        self.quadratic = np.array(spec['quadratic'])
+        self.categorical = {col: {c: w for c, w in pairs} for col, pairs in spec['categorical'].items()}
+
+    @classmethod
+    def load(cls, path):
+        with open(path) as f:
+            return cls(json.load(f))
+
+    @classmethod
+    def from_training(cls, model, poly_transformer, ohe, numeric_cols, categorical_cols):
+        return cls(export_cost_model(model, poly_transformer, ohe, numeric_cols, categorical_cols))
+
+    def _category_lookup(self, col, labels):
+        weights = self.categorical.get(col, {})
+        return np.array([weights.get(l, 0.0) for l in labels], dtype=np.float64)
+
+    def score_rows(self, rows, base_weights, out):
+        """Costs of feature rows whose base column holds codes into `base_weights`; written into `out`."""
+        x = rows[:, self.numeric_idx]
+        np.dot(x, self.linear, out=out)
+        out += np.einsum('ij,jk,ik->i', x, self.quadratic, x)
+        out += self.intercept
+        if 'base' in self.categorical:
+            out += base_weights[rows[:, FEATURE_COLUMNS.index('base')].astype(np.int64)]
+        if 'multi_day_flag' in self.categorical:
+            out += self._category_lookup('multi_day_flag', [0, 1])[rows[:, FEATURE_COLUMNS.index('multi_day_flag')]
+                                                                  .astype(np.int64)]
+        return out
+
+    def score_features(self, features, base_labels, out=None):
+        """Scores a pairing_features_batch matrix (with its base labels)."""
+        if out is None:
+            out = np.empty(len(features), dtype=np.float64)
+        return self.score_rows(features, self._category_lookup('base', base_labels), out)
+
+    def score_pairings(self, pairings, leg_dict, schedule_dict, leg_table=None, out=None, n_threads=None):
+        """
+        Feature extraction fused with scoring: each chunk's features live only in a chunk-sized scratch buffer and
+        its costs go straight into `out` (e.g. the solver's cost vector). Returns `out`.
+        """
+        if leg_table is None:
+            leg_table = leg_table_from_dict(leg_dict)
+        csr = pairings_to_csr(pairings, leg_table, schedule_dict)
+        n = len(pairings)
+        if out is None:
+            out = np.empty(n, dtype=np.float64)
+        base_labels, base_codes = _base_codes(csr)
+        base_weights = self._category_lookup('base', base_labels)
+
+        def run(ab):
+            a, b = ab
+            rows = np.empty((b - a, len(FEATURE_COLUMNS)), dtype=np.float64)
+            _features_chunk(csr, leg_table, base_codes, rows, a, b)
+            self.score_rows(rows, base_weights, out[a:b])
+
+        with trace.span("features.score", pairings=n), \
+                ThreadPoolExecutor(max_workers=n_threads or os.cpu_count()) as pool:
+            list(pool.map(run, _chunks(n)))
+        trace.count("features.rows", n)
+        return out
+
+    def as_scorer(self, leg_table, schedule_dict=None):
+        """Callable scoring a list of pool dicts ("base", "duties"): the `scorer` of Phase 3's guided generation."""
+        schedule_dict = schedule_dict or {}
+        return lambda pairings: self.score_pairings(pairings, None, schedule_dict, leg_table=leg_table, n_threads=1)
+
+    def score_pool(self, path, leg_dict, schedule_dict, leg_table=None, n_threads=None):
+        """
+        Scores a Phase 3 pool file (pool_store.py) one stored chunk at a time, so only a chunk of pairings is ever
+        expanded into dicts. Pool pairings carry no schedule link, so the schedule features score as 0. Returns the
+        predicted costs in pool order.
+        """
+        from pool_store import PoolReader
+
+        if leg_table is None:
+            leg_table = leg_table_from_dict(leg_dict)
+        reader = PoolReader(path)
+        parts = []
+        for chunk in reader.chunks():
+            pairings = [{'base': reader.bases[chunk.base_ids[k]],
+                         'duties': reader.legs.decode(chunk.pairing(k))} for k in range(len(chunk))]
+            parts.append(self.score_pairings(pairings, leg_dict, schedule_dict, leg_table=leg_table,
+                                             n_threads=n_threads))
+        return np.concatenate(parts) if parts else np.empty(0, dtype=np.float64)
+
+
+def predict_costs_fast(cost_model, pairings, leg_dict, schedule_dict, leg_table=None):
+    """predict_costs through a CompiledCostModel: same `pred_cost` values, no expanded design matrix."""
+    costs = cost_model.score_pairings(pairings, leg_dict, schedule_dict, leg_table=leg_table)
+    for p, pred in zip(pairings, costs):
+        p['pred_cost'] = pred
+    return pairings
+
 # -------------------------------
 # 8. Main execution
 # -------------------------------
 
 def main(day_files_folder="/content/sample_data",
          schedules_file="/content/sample_data/schedules.txt",
-         pairings_file="/content/sample_data/pairings.txt"):
+         pairings_file="/content/sample_data/pairings.txt",
+         cost_model_file=None,
+         sweep_degrees=None):
     """
     Main execution flow.
 
@@ -1324,6 +1868,9 @@ def main(day_files_folder="/content/sample_data",
         day_files_folder: Path to folder containing day_1.csv through day_31.csv
         schedules_file: Path to schedules.txt
         pairings_file: Path to pairings.txt
+        cost_model_file: Optional path to export the compiled cost model (JSON) to
+        sweep_degrees: Optional polynomial degrees to pick degree/alpha from by a CV sweep (cv_sweep); limited to
+            degree <= 2 when cost_model_file is set
 
     Returns:
         dict: Contains model, pairings, leg_dict, schedule_dict
@@ -1366,7 +1913,20 @@ def main(day_files_folder="/content/sample_data",
 
     # Step 5: Train model
     print("\n[5/6] Training predictive model...")
-    model, poly, ohe, num_cols, cat_cols = train_and_cv(X, y, groups, degree=2, alpha=1.0)
+    degree, alpha = 2, 1.0
+    if sweep_degrees and cost_model_file:
+        # export_cost_model folds degree <= 2 only: don't let the sweep pick a model that cannot be exported
+        exportable = [d for d in sweep_degrees if d <= 2]
+        if len(exportable) < len(sweep_degrees):
+            print(f"Note: sweeping degrees {exportable} only (cost model export supports degree <= 2)")
+        sweep_degrees = exportable
+    if sweep_degrees:
+        sweep = cv_sweep(X, y, groups, degrees=sweep_degrees)
+        if sweep:
+            degree, alpha = sweep[0]['degree'], sweep[0]['alpha']
+    model, poly, ohe, num_cols, cat_cols = train_and_cv(X, y, groups, degree=degree, alpha=alpha)
+    if cost_model_file:
+        export_cost_model(model, poly, ohe, num_cols, cat_cols, cost_model_file)
 
     # Step 6: Make predictions
     print("\n[6/6] Making predictions...")
@@ -1392,6 +1952,11 @@ def main(day_files_folder="/content/sample_data",
     }
 
 if __name__ == "__main__":
+    import sys
+    if "--check-cv-sweep" in sys.argv:
+        check_cv_sweep()
+        sys.exit(0)
+
     # Default paths for Colab
     results = main(
         day_files_folder="/content/sample_data/instance1/",
@@ -12,6 +12,14 @@ Three generation modes are supported:
     - forced: perturbations that protect low-frequency (“forced”) duties
     - mixed: a weighted combination of local, forced, and mild recombination
 
+Given a flight_network.FlightNetwork of the instance (day_*.csv), the
+generators only keep operationally valid pairings: every leg connects
+to the next (same airport, minimum sit), duty and pairing limits hold,
+and the pairing starts and ends at the base it is assigned to. Legs are
+then interned against the network's leg table, so a leg code is also
+the leg's position in the network and each step is an O(1) check.
+Without a network the sequences are kept unchecked, as before.
+
 The resulting samples are intended for downstream optimization
 (e.g., set partitioning experiments) and benchmarking generation speed
 under different target sizes and time limits.
@@ -23,17 +31,24 @@ for repeatable batch execution.
 
 
 import time
-import json
+import os
 import random
 import re
+from array import array
 from collections import Counter, defaultdict
+from concurrent.futures import ProcessPoolExecutor
 from pathlib import Path
 
+import pipeline_trace as trace
+from flight_network import FlightNetwork
+from leg_dictionary import LegDictionary, PairingArena, joined_key, leg_id, span_key, span_prefix, window_key
+from pool_store import PoolWriter
+
 
 
 def parse_solution(filepath):
 
-        """
+    """
     Parse an initial pairing solution file into a normalized in-memory
     representation.
 
@@ -70,9 +85,29 @@ def parse_solution(filepath):
 
 
 
+def intern_solution(solution, legs):
+
+    """
+    Interned view of a parsed solution: same pairings, with each duty
+    sequence replaced by its list of integer leg codes from `legs`
+    (a shared LegDictionary). The generators below work unchanged on
+    either representation; sampling on codes keeps hashing and
+    comparison on small ints instead of strings.
+
+    Each interned pairing also carries the prefix hashes of its codes
+    ("prefix", see `leg_dictionary.span_prefix`), from which the key of
+    any neighbour follows without building it.
+    """
+    out = []
+    for p in solution:
+        codes = legs.encode(p["duties"])
+        out.append({"id": p["id"], "base": p["base"], "duties": codes, "prefix": span_prefix(codes)})
+    return out
+
+
 def cheap_cost(duties):
 
-        """
+    """
     Assign a simple proxy cost to a pairing based solely on length.
 
     This is intentionally crude and is only meant to provide a consistent,
@@ -98,7 +133,7 @@ def cheap_cost(duties):
 
 def local_perturb(pairing):
 
-        """
+    """
     Generate small structural variations of a single pairing.
 
     The perturbations are conservative by design: removing interior
@@ -116,30 +151,50 @@ def local_perturb(pairing):
     list of list
         Candidate duty sequences derived from the original.
     """
-    
     d = pairing["duties"]
-    out = []
+    return [window_of(d, w) for w in local_windows(len(d))]
 
-    if len(d) > 2:
-        out.append(d[1:])
-        out.append(d[:-1])
 
-    for i in range(1, len(d) - 1):
-        nd = d[:i] + d[i+1:]
-        if len(nd) >= 2:
-            out.append(nd)
+_LOCAL_WINDOWS = {}
 
-    mid = len(d) // 2
-    if mid >= 2 and len(d) - mid >= 2:
-        out.append(d[:mid])
-        out.append(d[mid:])
 
-    return out
+def local_windows(n):
+
+    """
+    The `local_perturb` neighbourhood of any pairing of length `n`, as
+    (start, stop, skip) windows over the source sequence: the candidate
+    is duties[start:stop] without position `skip` (-1 for none). The
+    windows depend on the length only, so they are built once per
+    length and shared by every draw.
+    """
+    windows = _LOCAL_WINDOWS.get(n)
+    if windows is None:
+        out = []
+        if n > 2:
+            out.append((1, n, -1))     # trim first
+            out.append((0, n - 1, -1)) # trim last
+            for i in range(1, n - 1):  # remove one interior duty
+                out.append((0, n, i))
+        mid = n // 2
+        if mid >= 2 and n - mid >= 2:  # split in half
+            out.append((0, mid, -1))
+            out.append((mid, n, -1))
+        windows = _LOCAL_WINDOWS[n] = tuple(out)
+    return windows
+
+
+def window_of(d, window):
+
+    """Materializes one (start, stop, skip) window of `d` as a list."""
+    a, b, skip = window
+    if a <= skip < b:
+        return d[a:skip] + d[skip + 1:b]
+    return d[a:b]
 
 
 def forced_duty_generators(solution):
 
-        """
+    """
     Identify low-frequency (“forced”) duties and the pairings that contain them.
 
     A forced duty is defined here as a duty that appears exactly once
@@ -174,14 +229,18 @@ def forced_duty_generators(solution):
     return forced, by_duty
 
 
-def forced_alternative(duty, source_pairing):
+def forced_alternative(duty, source_pairing, network=None):
 
-       """
+    """
     Construct a minimal alternative pairing around a forced duty.
 
     The intent is to keep the forced duty covered while shortening or
-    reshaping the sequence as little as possible. Only local two-duty
-    windows are considered.
+    reshaping the sequence as little as possible. Without a network only
+    local two-duty windows are considered; with one, the shortest
+    window of the source pairing around the duty that is itself a legal
+    pairing (base to base) is returned. Windows of a legal pairing
+    already connect and respect the duty limits, so only the base
+    condition can fail.
 
     Parameters
     ----------
@@ -189,6 +248,8 @@ def forced_alternative(duty, source_pairing):
         The forced duty of interest.
     source_pairing : dict
         Pairing that contains the forced duty.
+    network : FlightNetwork, optional
+        Flight network the duties are interned against.
 
     Returns
     -------
@@ -196,23 +257,166 @@ def forced_alternative(duty, source_pairing):
         A short duty sequence containing the forced duty, or None if
         no valid alternative exists.
     """
+    window = forced_window(duty, source_pairing, network)
+    return window_of(source_pairing["duties"], window) if window else None
+
+
+def forced_window(duty, source_pairing, network=None):
+
+    """`forced_alternative` as a (start, stop, -1) window of the source pairing, or None."""
     i = source_pairing["duties"].index(duty)
     d = source_pairing["duties"]
 
+    if network is not None:
+        for width in range(2, len(d)):
+            for a in range(max(0, i - width + 1), min(i, len(d) - width) + 1):
+                if network.pairing_base([leg_id(c) for c in d[a:a + width]]) is not None:
+                    return a, a + width, -1
+        return None
+
     if i > 0:
-        return d[i-1:i+1]
+        return i - 1, i + 1, -1
     if i < len(d) - 1:
-        return d[i:i+2]
+        return i, i + 2, -1
 
     return None
 
 
+def recombine(p1, p2, network=None):
+
+    """
+    Mild recombination of two pairings: the first half of `p1` followed
+    by the second half of `p2`. With a network, the splice point in
+    `p2` is moved to the first leg that the last leg of the prefix can
+    connect to, so the junction is a real connection.
+    """
+    splice = recombine_splice(p1, p2, network)
+    if splice is None:
+        return []
+    cut, t = splice
+    return p1["duties"][:cut] + p2["duties"][t:]
+
+
+def recombine_splice(p1, p2, network=None):
+
+    """`recombine` as (cut, t): the child is p1[:cut] + p2[t:]; None when no junction connects."""
+    cut = min(len(p1["duties"]), len(p2["duties"])) // 2
+    if network is None or cut == 0:
+        return cut, cut
+
+    k = leg_id(p1["duties"][cut - 1])
+    for t, c in enumerate(p2["duties"]):
+        if network.connects(k, leg_id(c)):
+            return cut, t
+    return None
+
+
+def candidate_base(duties, network, solution, rng):
+
+    """
+    Base for a candidate duty sequence (integer leg codes). Without a
+    network a random solution base is drawn, as before; with one, the
+    sequence must be a legal pairing and its own base is returned, or
+    None when it is not.
+    """
+    if network is None:
+        return rng.choice(solution)["base"]
+    return network.pairing_base([leg_id(c) for c in duties])
+
+
+def propose_candidates(mode, solution, forced, forced_map, rng, network=None):
+
+    """
+    Draw one batch of candidate duty sequences for the given mode.
+
+    This is the sampling step shared by the sequential and parallel
+    generators. `rng` only needs `choice`, `random` and `sample`, so it
+    may be the `random` module itself or a per-worker `random.Random`.
+    `network` makes forced alternatives and recombinations
+    connection-aware (see `forced_alternative` and `recombine`).
+
+    Returns
+    -------
+    list of list
+        Candidate duty sequences (possibly empty).
+    """
+    seq, windows, _ = propose_windows(mode, solution, forced, forced_map, rng, network)
+    return [window_of(seq, w) for w in windows]
+
+
+_NO_WINDOWS = ()
+
+
+def local_keys(pairing):
+
+    """
+    `span_key`s of the `local_windows` neighbours of an interned
+    pairing, computed from its prefix hashes (O(1) per neighbour) the
+    first time the pairing is drawn and cached on it afterwards.
+    """
+    keys = pairing.get("local_keys")
+    if keys is None:
+        prefix = pairing["prefix"]
+        keys = pairing["local_keys"] = tuple(
+            window_key(prefix, a, b, skip) for a, b, skip in local_windows(len(pairing["duties"])))
+    return keys
+
+
+def propose_windows(mode, solution, forced, forced_map, rng, network=None):
+
+    """
+    `propose_candidates` as lazy edits: returns the source sequence,
+    the (start, stop, skip) windows over it that are the candidates
+    (see `local_windows`) and their `span_key`s, drawing from `rng`
+    exactly as `propose_candidates` does. Every window is at least two
+    duties long and its `skip`, when set, lies inside it. Keys are
+    taken from the rolling prefix hashes of interned pairings, so a
+    candidate is only sliced out of its source once it turns out to be
+    new; for pairings without "prefix" the keys are None.
+    """
+    if mode == "mixed":
+        r = rng.random()
+        mode = "local" if r < 0.6 else "forced" if r < 0.9 else "recombine"
+    if mode == "recombine" and len(solution) < 2:
+        mode = "local"          # a worker's slice can hold a single pairing: nothing to recombine it with
+
+    if mode == "local":
+        src = rng.choice(solution)
+        windows = local_windows(len(src["duties"]))
+        return src["duties"], windows, (local_keys(src) if "prefix" in src else None)
+
+    if mode == "forced":
+        d = rng.choice(forced)
+        src = rng.choice(forced_map[d])
+        window = forced_window(d, src, network)
+        if window is None:
+            return src["duties"], _NO_WINDOWS, _NO_WINDOWS
+        return src["duties"], (window,), ((window_key(src["prefix"], *window),) if "prefix" in src else None)
+
+    if mode == "recombine":
+        # mild random recombination
+        p1, p2 = rng.sample(solution, 2)
+        splice = recombine_splice(p1, p2, network)
+        if splice is None or splice[0] + len(p2["duties"]) - splice[1] < 2:
+            return [], _NO_WINDOWS, _NO_WINDOWS
+        cut, t = splice
+        seq = p1["duties"][:cut] + p2["duties"][t:]
+        return seq, ((0, len(seq), -1),), ((joined_key(p1["prefix"], cut, p2["prefix"], t),) if "prefix" in p1
+                                           else None)
+
+    raise ValueError(f"Unknown mode {mode}")
+
+
 def generate_sample(
     solution,
     target_size,
     time_limit,
     mode,
-    seed=0
+    seed=0,
+    network=None,
+    scorer=None,
+    duals=None,
+    max_reduced_cost=None
 ):
 
     """
@@ -222,6 +426,10 @@ def generate_sample(
     expands the pool until either the target size is reached or the
     time limit expires. Duplicate duty sequences are filtered.
 
+    mode="guided" samples toward the legs the solver needs: see
+    `generate_guided`, which also takes `scorer`, `duals` and
+    `max_reduced_cost` (ignored by the other modes).
+
     Parameters
     ----------
     solution : list of dict
@@ -231,9 +439,12 @@ def generate_sample(
     time_limit : float
         Maximum generation time in seconds.
     mode : str
-        Sampling strategy: "local", "forced", or "mixed".
+        Sampling strategy: "local", "forced", "mixed" or "guided".
     seed : int, optional
         RNG seed for reproducibility.
+    network : FlightNetwork, optional
+        When given, only legal pairings are kept and each is assigned
+        its own base.
 
     Returns
     -------
@@ -243,81 +454,466 @@ def generate_sample(
         elapsed : float
             Wall-clock time spent generating samples.
     """
+    if mode == "guided":
+        return generate_guided(solution, target_size, time_limit, seed, network, scorer, duals, max_reduced_cost)
+
     random.seed(seed)
     start = time.time()
 
-    pool = []
+    legs = LegDictionary.from_leg_table(network.legs) if network else LegDictionary()
+    isolution = intern_solution(solution, legs)
+
     seen = set()
 
     # always include solution pairings
-    for p in solution:
-        key = tuple(p["duties"])
-        seen.add(key)
-        pool.append({
-            "base": p["base"],
-            "duties": p["duties"],
-            "cost": cheap_cost(p["duties"])
-        })
+    for p in isolution:
+        seen.add(span_key(p["duties"]))
 
-    forced, forced_map = forced_duty_generators(solution)
+    forced, forced_map = forced_duty_generators(isolution)
+    arena, base_names = PairingArena(), {}
+    remaining = target_size - len(solution)
+    proposed = duplicates = illegal = 0
 
-    while len(pool) < target_size and time.time() - start < time_limit:
-        if mode == "local":
-            src = random.choice(solution)
-            candidates = local_perturb(src)
-
-        elif mode == "forced":
-            d = random.choice(forced)
-            src = random.choice(forced_map[d])
-            alt = forced_alternative(d, src)
-            candidates = [alt] if alt else []
-
-        elif mode == "mixed":
-            r = random.random()
-            if r < 0.6:
-                src = random.choice(solution)
-                candidates = local_perturb(src)
-            elif r < 0.9:
-                d = random.choice(forced)
-                src = random.choice(forced_map[d])
-                alt = forced_alternative(d, src)
-                candidates = [alt] if alt else []
-            else:
-                # mild random recombination
-                p1, p2 = random.sample(solution, 2)
-                cut = min(len(p1["duties"]), len(p2["duties"])) // 2
-                candidates = [p1["duties"][:cut] + p2["duties"][cut:]]
+    accepted = 0
+
+    while accepted < remaining and time.time() - start < time_limit:
+        seq, windows, keys = propose_windows(mode, isolution, forced, forced_map, random, network)
+        proposed += len(windows)
+
+        for (a, b, skip), key in zip(windows, keys):
+            if key in seen:
+                duplicates += 1
+                continue
+
+            seen.add(key)
+            d = seq[a:skip] + seq[skip + 1:b] if skip >= 0 else seq[a:b]
+            arena.stage(d)
+            base = candidate_base(d, network, solution, random)
+            if base is None:
+                illegal += 1
+                arena.rollback()
+                continue
+            arena.commit(base_names.setdefault(base, len(base_names)))
+            accepted += 1
 
+            if accepted >= remaining:
+                break
+
+    elapsed = time.time() - start
+    _report(mode, proposed, duplicates, illegal, accepted, elapsed)
+    return _pool_dicts(solution, arena, list(base_names), legs), elapsed
+
+
+def _pool_dicts(solution, arena, base_names, legs):
+    """The solution pairings followed by the arena's pairings, as pool dicts."""
+    pool = [{"base": p["base"], "duties": p["duties"], "cost": cheap_cost(p["duties"])} for p in solution]
+    for j, d in enumerate(arena):
+        pool.append({"base": base_names[arena.bases[j]], "duties": legs.decode(d), "cost": cheap_cost(d)})
+    return pool
+
+
+def _report(mode, proposed, duplicates, illegal, accepted, elapsed):
+    """Generation counters for pipeline_trace: candidates, `seen` hits, rejected pairings and the column rate."""
+    if not trace.enabled():
+        return
+    trace.count(f"generate.{mode}.candidates", proposed)
+    trace.count(f"generate.{mode}.duplicates", duplicates)
+    trace.count(f"generate.{mode}.illegal", illegal)
+    trace.count(f"generate.{mode}.columns", accepted)
+    trace.gauge(f"generate.{mode}.duplicate_rate", duplicates / proposed if proposed else 0.0)
+    trace.gauge(f"generate.{mode}.columns_per_s", accepted / elapsed if elapsed > 0 else 0.0)
+
+
+# --------------------------------------------------
+# Guided generation
+# --------------------------------------------------
+
+GUIDED_BATCH = 256        # candidates scored together; source weights are rebuilt after every batch
+GUIDED_RECOMBINE = 0.1    # share of draws that splice two weighted sources instead of perturbing one
+
+
+class AliasTable:
+
+    """
+    Walker/Vose alias table over non-negative weights: O(n) to build,
+    O(1) per weighted draw (one index and one coin). All-zero weights
+    fall back to uniform draws.
+    """
+
+    def __init__(self, weights):
+        n = len(weights)
+        total = float(sum(weights))
+        if total <= 0:
+            weights, total = [1.0] * n, float(n)
+        prob = [w * n / total for w in weights]
+        alias = list(range(n))
+        small = [i for i, q in enumerate(prob) if q < 1.0]
+        large = [i for i, q in enumerate(prob) if q >= 1.0]
+        while small and large:
+            s, l = small.pop(), large.pop()
+            alias[s] = l
+            prob[l] -= 1.0 - prob[s]
+            (small if prob[l] < 1.0 else large).append(l)
+        for i in small + large:
+            prob[i] = 1.0
+        self.n = n
+        self.prob = prob
+        self.alias = alias
+
+    def draw(self, rng):
+        i = int(rng.random() * self.n)
+        return i if rng.random() < self.prob[i] else self.alias[i]
+
+
+def _leg_weights(n_legs, cover, dual):
+    """Per leg id: (positive dual, or the mean positive dual when there are none) / current coverage."""
+    positive = [v for v in dual if v > 0]
+    floor = sum(positive) / len(positive) if positive else 1.0
+    return [(max(dual[i], 0.0) + floor) / cover[i] if cover[i] else max(dual[i], 0.0) + floor
+            for i in range(n_legs)]
+
+
+def generate_guided(solution, target_size, time_limit, seed=0, network=None, scorer=None, duals=None,
+                    max_reduced_cost=None):
+
+    """
+    Cost-aware counterpart of `generate_sample` (mode="guided").
+
+    Sources are drawn from an alias table instead of uniformly: a
+    pairing's weight is the sum over its legs of the leg's dual price
+    (from `duals`, {leg name: dual}, e.g. SPPFromCSV.leg_duals(); the
+    TDH_/PAL_ variants of a leg share one price) divided by how many
+    pool pairings already cover the leg, so expensive and poorly
+    covered legs are sampled more. Weights are rebuilt after every
+    GUIDED_BATCH candidates. Each draw yields the local neighbourhood
+    of the source or, in GUIDED_RECOMBINE of the draws, a splice of two
+    weighted sources.
+
+    Candidates keep their source's base (their own base with a
+    `network`, which also restricts them to legal pairings) and are
+    scored in batches by `scorer`, a callable mapping a list of pool
+    dicts ("base", "duties") to costs, e.g.
+    phase_2_predict_cost_pipeline.CompiledCostModel.as_scorer(...);
+    without a scorer `cheap_cost` is used. With `max_reduced_cost`,
+    candidates whose cost minus the duals of their legs exceeds it are
+    dropped, so only columns that could enter the LP basis are kept.
+
+    Returns (pool, elapsed) like `generate_sample`.
+    """
+    rng = random.Random(seed)
+    start = time.time()
+
+    legs = LegDictionary.from_leg_table(network.legs) if network else LegDictionary()
+    isolution = intern_solution(solution, legs)
+    score = scorer or (lambda batch: [cheap_cost(p["duties"]) for p in batch])
+
+    n_legs = len(legs)
+    dual = [0.0] * n_legs
+    for name, v in (duals or {}).items():
+        i = leg_id(legs.code(name))
+        if i >= len(dual):
+            dual.extend([0.0] * (i + 1 - len(dual)))
+        dual[i] = max(dual[i], v)
+    n_legs = len(dual)
+    cover = [0] * n_legs
+    for p in isolution:
+        for c in p["duties"]:
+            cover[leg_id(c)] += 1
+
+    pool = [{"base": p["base"], "duties": p["duties"], "cost": c}
+            for p, c in zip(solution, score([{"base": p["base"], "duties": p["duties"]} for p in solution]))]
+    seen = {span_key(p["duties"]) for p in isolution}
+    proposed = duplicates = illegal = priced_out = 0
+    batch = []
+
+    def source_table():
+        w = _leg_weights(n_legs, cover, dual)
+        return AliasTable([sum(w[leg_id(c)] for c in p["duties"]) for p in isolution])
+
+    def flush():
+        nonlocal priced_out
+        costs = score(batch)
+        for p, cost in zip(batch, costs):
+            if max_reduced_cost is not None:
+                rc = cost - sum(dual[leg_id(c)] for c in p["codes"])
+                if rc > max_reduced_cost:
+                    priced_out += 1
+                    continue
+            for c in p.pop("codes"):
+                cover[leg_id(c)] += 1
+            p["cost"] = cost
+            pool.append(p)
+            if len(pool) >= target_size:
+                break
+        batch.clear()
+
+    table = source_table()
+    while len(pool) < target_size and time.time() - start < time_limit:
+        src = isolution[table.draw(rng)]
+        if rng.random() < GUIDED_RECOMBINE:
+            other = isolution[table.draw(rng)]
+            splice = recombine_splice(src, other, network)
+            if splice is None or splice[0] + len(other["duties"]) - splice[1] < 2:
+                continue
+            cut, t = splice
+            seq = src["duties"][:cut] + other["duties"][t:]
+            windows, keys = ((0, len(seq), -1),), (joined_key(src["prefix"], cut, other["prefix"], t),)
         else:
-            raise ValueError(f"Unknown mode {mode}")
+            seq, windows, keys = src["duties"], local_windows(len(src["duties"])), local_keys(src)
+        proposed += len(windows)
 
-        for d in candidates:
-            if not d or len(d) < 2:
+        for (a, b, skip), key in zip(windows, keys):
+            if key in seen:
+                duplicates += 1
                 continue
+            seen.add(key)
+            d = seq[a:skip] + seq[skip + 1:b] if skip >= 0 else seq[a:b]
+            base = network.pairing_base([leg_id(c) for c in d]) if network else src["base"]
+            if base is None:
+                illegal += 1
+                continue
+            batch.append({"base": base, "duties": legs.decode(d), "codes": d})
+
+        if len(batch) >= GUIDED_BATCH:
+            flush()
+            table = source_table()
+    if batch and len(pool) < target_size:
+        flush()
+
+    elapsed = time.time() - start
+    _report("guided", proposed, duplicates, illegal, len(pool) - len(solution), elapsed)
+    trace.count("generate.guided.priced_out", priced_out)
+    return pool, elapsed
+
+
+# --------------------------------------------------
+# Parallel generation
+# --------------------------------------------------
+
+DEDUP_SHARDS = 64
+STALL_DRAWS = 20_000   # consecutive draws without a new pairing before a worker gives up
 
-            key = tuple(d)
+
+class ShardedKeySet:
+
+    """
+    Set of 61-bit sequence keys (see `leg_dictionary.span_key`) split
+    into independent shards.
+
+    The shard is picked from the low bits of the key, so each shard
+    stays small and shards can be filled or checked independently.
+    """
+
+    def __init__(self, n_shards=DEDUP_SHARDS):
+        self.mask = n_shards - 1
+        self.shards = [set() for _ in range(n_shards)]
+
+    def add(self, key):
+        """Insert `key`; returns False when it was already present."""
+        shard = self.shards[key & self.mask]
+        if key in shard:
+            return False
+        shard.add(key)
+        return True
+
+    def __len__(self):
+        return sum(len(s) for s in self.shards)
+
+
+def _generate_worker(solution, sources, forced_slice, quota, deadline, mode, seed, worker, round_no, emitted,
+                     network=None):
+
+    """
+    One generation worker over an interned solution (integer leg
+    codes): its own RNG stream and its own slice of the
+    neighbourhood (`sources` pairings and `forced_slice` duties), so
+    workers rarely propose the same sequence. `emitted` holds the keys
+    this worker returned in earlier rounds. The worker stops at `quota`
+    new pairings, at the shared `deadline`, or once STALL_DRAWS draws
+    in a row produced nothing new. Illegal candidates (with a `network`)
+    are remembered in `seen` so they are checked only once.
+
+    New candidates are staged in a PairingArena and rolled back when
+    they are illegal, so accepted pairings share one code buffer.
+    Returns (keys, arena, base names, counts): the accepted pairings
+    in one contiguous buffer, their `span_key`s, the names their base
+    ids refer to, and (proposed, duplicates, illegal) candidate
+    windows for the generation counters.
+    """
+    rng = random.Random(f"{seed}:{round_no}:{worker}")
+    _, forced_map = forced_duty_generators(solution)
+    seen = {span_key(p["duties"]) for p in solution}
+    seen.update(emitted)
+    arena, accepted_keys, base_names = PairingArena(), array("q"), {}
+    stalled = accepted = proposed = duplicates = illegal = 0
+
+    if not sources or (mode == "forced" and not forced_slice):
+        return accepted_keys, arena, [], (0, 0, 0)
+    if mode == "mixed" and not forced_slice:
+        mode = "local"
+
+    while accepted < quota and stalled < STALL_DRAWS and time.time() < deadline:
+        stalled += 1
+        seq, windows, keys = propose_windows(mode, sources, forced_slice, forced_map, rng, network)
+        proposed += len(windows)
+        for (a, b, skip), key in zip(windows, keys):
             if key in seen:
+                duplicates += 1
                 continue
 
             seen.add(key)
-            pool.append({
-                "base": random.choice(solution)["base"],
-                "duties": d,
-                "cost": cheap_cost(d)
-            })
+            d = seq[a:skip] + seq[skip + 1:b] if skip >= 0 else seq[a:b]
+            arena.stage(d)
+            base = candidate_base(d, network, solution, rng)
+            if base is None:
+                arena.rollback()
+                illegal += 1
+                continue
+            stalled = 0
+            arena.commit(base_names.setdefault(base, len(base_names)))
+            accepted_keys.append(key)
+            accepted += 1
 
-            if len(pool) >= target_size:
+            if accepted >= quota:
                 break
 
-    return pool, time.time() - start
+    return accepted_keys, arena, list(base_names), (proposed, duplicates, illegal)
 
 
+def generate_sample_parallel(
+    solution,
+    target_size,
+    time_limit,
+    mode,
+    seed=0,
+    workers=None,
+    sink=None,
+    network=None,
+    scorer=None,
+    duals=None,
+    max_reduced_cost=None,
+    round_quota=None
+):
+
+    """
+    Parallel counterpart of `generate_sample`.
+
+    Each worker process runs the same local/forced/mixed sampling with
+    its own seeded RNG stream (derived from `seed`, the round and the
+    worker number) over its own slice of source pairings and forced
+    duties, so the pool is reproducible for a given seed and worker
+    count whenever the time limit is not hit. Worker outputs are merged
+    in worker order through a sharded set of 61-bit keys of the
+    interned leg-code sequences.
+    Workers that fall short of their quota are treated as exhausted and
+    the remaining quota is redistributed over the others.
+
+    When `sink` (a pool_store.PoolWriter) is given, pairings are
+    appended to it as they are accepted instead of being collected, so
+    memory does not grow with the pool. `network` restricts the pool
+    to legal pairings, as in `generate_sample`. mode="guided" (with
+    `scorer`, `duals` and `max_reduced_cost`) runs `generate_guided` in
+    this process and streams its pool to `sink`. `round_quota` caps
+    what each worker proposes per round, so a streaming `sink` receives
+    pairings every round instead of once the quota or deadline is hit.
+
+    Returns
+    -------
+    tuple
+        pool : list of dict, or int
+            Generated pairing candidates with bases and costs (the
+            number of pairings written when streaming to `sink`).
+        elapsed : float
+            Wall-clock time spent generating samples.
+    """
+    if mode == "guided":
+        # guided sampling reweights its sources after every batch, so it runs in this process
+        pool, elapsed = generate_guided(solution, target_size, time_limit, seed, network, scorer, duals,
+                                        max_reduced_cost)
+        if sink is None:
+            return pool, elapsed
+        for p in pool:
+            sink.append(p["duties"], p["base"], p["cost"])
+        return len(pool), elapsed
+
+    workers = max(1, min(workers or os.cpu_count() or 1, len(solution)))
+    start = time.time()
+    deadline = start + time_limit
+
+    legs = LegDictionary.from_leg_table(network.legs) if network else LegDictionary()
+    isolution = intern_solution(solution, legs)
+
+    pool = []
+    size = 0
+    seen = ShardedKeySet()
+
+    def emit(base, duties, cost):
+        nonlocal size
+        size += 1
+        if sink is not None:
+            sink.append(duties, base, cost)
+        else:
+            pool.append({"base": base, "duties": duties, "cost": cost})
+
+    # always include solution pairings
+    for p, ip in zip(solution, isolution):
+        seen.add(span_key(ip["duties"]))
+        emit(p["base"], p["duties"], cheap_cost(p["duties"]))
+
+    forced, _ = forced_duty_generators(isolution)
+    emitted = [set() for _ in range(workers)]
+    active = list(range(workers))
+    round_no = 0
+    proposed = duplicates = illegal = 0
+
+    with ProcessPoolExecutor(max_workers=workers) as executor:
+        while active and size < target_size and time.time() < deadline:
+            round_span = trace.span("generate.round", mode=mode, round=round_no, workers=len(active))
+            with round_span:
+                quota = -(-(target_size - size) // len(active))
+                if round_quota:
+                    quota = min(quota, round_quota)
+                futures = [
+                    (w, executor.submit(
+                        _generate_worker, isolution, isolution[w::workers], forced[w::workers],
+                        quota, deadline, mode, seed, w, round_no, emitted[w], network))
+                    for w in active
+                ]
+
+                still_active = []
+                for w, fut in futures:
+                    keys, arena, base_names, (w_proposed, w_duplicates, w_illegal) = fut.result()
+                    if len(arena) >= quota:
+                        still_active.append(w)
+                    proposed += w_proposed
+                    duplicates += w_duplicates
+                    illegal += w_illegal
+                    emitted[w].update(keys)
+                    for j, key in enumerate(keys):
+                        if size >= target_size:
+                            break
+                        if seen.add(key):
+                            d = arena[j]
+                            emit(base_names[arena.bases[j]], legs.decode(d), cheap_cost(d))
+                        else:
+                            duplicates += 1
+                round_span.set(pool=size)
+
+            active = still_active
+            round_no += 1
+
+    elapsed = time.time() - start
+    # duplicates: `seen` hits inside the workers plus cross-worker hits at the merge
+    _report(mode, proposed, duplicates, illegal, size - len(solution), elapsed)
+    return (size if sink is not None else pool), elapsed
+
 # --------------------------------------------------
 # Main driver
 # --------------------------------------------------
 
 if __name__ == "__main__":
     solution = parse_solution("/content/sample_data/initialSolution.txt")
+    network = FlightNetwork.from_instance("/content/sample_data")
 
     configs = [
         ("0K",        0,       10),
@@ -337,17 +933,17 @@ if __name__ == "__main__":
         print(f"\n=== Generating {name} samples ===")
 
         for mode in modes:
-            pool, elapsed = generate_sample(
-                solution,
-                target_size=max(target, len(solution)),
-                time_limit=time_limit,
-                mode=mode,
-                seed=42
-            )
-
-            outfile = dirpath / f"{mode}.json"
-            with open(outfile, "w") as f:
-                json.dump(pool, f, indent=2)
-
-            print(f"{mode:>6}: {len(pool):>7} pairings "
-                  f"in {elapsed:5.1f}s")
+            outfile = dirpath / f"{mode}.pool"
+            with PoolWriter(outfile) as sink:
+                n_written, elapsed = generate_sample_parallel(
+                    solution,
+                    target_size=max(target, len(solution)),
+                    time_limit=time_limit,
+                    mode=mode,
+                    seed=42,
+                    sink=sink,
+                    network=network
+                )
+
+            print(f"{mode:>6}: {n_written:>7} pairings "
+                  f"in {elapsed:5.1f}s -> {outfile}")
@@ -3,14 +3,18 @@
 
 This module implements a CSV-driven Set Partitioning solver for crew pairing selection. Given a universe of flight legs and a 
 candidate set of pairings, it formulates a binary integer program that selects a minimum-cost subset of pairings covering each 
-leg exactly once. The implementation emphasizes robustness to incomplete inputs, supports externally provided incidence and 
-cost data, and includes basic infeasibility diagnostics to aid data validation and model debugging.
+operating leg exactly once and each deadhead (TDH_) leg at least once, since several crews may ride one flight as passengers
+(exact_deadheads=True partitions deadhead legs too). The implementation emphasizes robustness to incomplete inputs, supports
+externally provided incidence and cost data, and includes basic infeasibility diagnostics to aid data validation and model 
+debugging.
 
 MODEL LOGIC:
 
-# constraints: each leg at least once
+# constraints: each leg once, deadhead legs at least once (sparse rows of the incidence matrix; see cover_rows())
+cover = self.cover_rows()
 for i in range(self.m):
-    prob += lpSum(self.a[i][j] * x[j] for j in range(self.n)) >= 1
+    covered = lpSum(x[j] for j in self.a.row(i))
+    prob += covered >= 1 if cover[i] else covered == 1
 
 
 
@@ -20,9 +24,234 @@ for i in range(self.m):
 # ============================================================
 
 import csv
+import os
+import re
+from array import array
+from concurrent.futures import ThreadPoolExecutor
 from pathlib import Path
 import pulp
 import sys
+import time
+
+import pipeline_trace as trace
+from leg_dictionary import LegDictionary, is_deadhead, leg_id
+import spp_presolve
+from spp_diagnostics import CoverageDiagnostics
+from spp_heuristic import SPPHeuristic
+
+try:
+    import highspy
+except ImportError:  # optional in-memory backend
+    highspy = None
+
+LEG_DAY = re.compile(r"LEG_(\d+)_\d+$")      # LEG_05_27 (with any TDH_/PAL_ prefix) flies on day 5
+
+
+def leg_day(name):
+    """Day number encoded in a leg id, or None for tokens that carry no day."""
+    match = LEG_DAY.search(name)
+    return int(match.group(1)) if match else None
+
+
+# ============================================================
+#  Sparse incidence (CSC + CSR transpose)
+# ============================================================
+def _compress(n_major, major, minor):
+    """
+    Counting-sort (major, minor) index pairs into a compressed layout: `ptr[k]:ptr[k+1]` delimits the minor indices of
+    major entry k. Each segment is sorted and de-duplicated so repeated triples collapse to a single 0/1 entry, exactly
+    as the dense matrix used to behave.
+    """
+    counts = array("I", bytes(4 * (n_major + 1)))
+    for k in major:
+        counts[k + 1] += 1
+    for k in range(n_major):
+        counts[k + 1] += counts[k]
+    fill = array("I", counts)
+    idx = array("I", bytes(4 * len(minor)))
+    for k, v in zip(major, minor):
+        idx[fill[k]] = v
+        fill[k] += 1
+
+    # sort + de-duplicate each segment into the packed output
+    ptr = array("I", [0])
+    out = array("I")
+    for k in range(n_major):
+        seg = sorted(set(idx[counts[k]:counts[k + 1]]))
+        out.extend(seg)
+        ptr.append(len(out))
+    return ptr, out
+
+
+class SparseIncidence:
+    """
+    Leg–pairing incidence matrix stored in compressed sparse column form together with its CSR transpose.
+
+    Column j (`col_ptr[j]:col_ptr[j+1]` into `row_idx`) lists the legs covered by pairing j; row i (`row_ptr[i]:row_ptr[i+1]`
+    into `col_idx`) lists the pairings covering leg i. All indices are 32-bit, so memory grows with the number of nonzeros
+    (a handful per pairing) instead of with m x n.
+    """
+
+    def __init__(self, m, n, col_ptr, row_idx):
+        self.m = m
+        self.n = n
+        self.col_ptr = col_ptr
+        self.row_idx = row_idx
+        # CSR transpose: walking columns in order keeps every row's pairing list sorted
+        rows = array("I")
+        for j in range(n):
+            rows.extend([j] * (col_ptr[j + 1] - col_ptr[j]))
+        self.row_ptr, self.col_idx = _compress(m, row_idx, rows)
+
+    @classmethod
+    def from_columns(cls, m, columns):
+        """Builds the matrix from a list holding one iterable of leg indices per pairing."""
+        pj = array("I")
+        li = array("I")
+        for j, legs in enumerate(columns):
+            for i in legs:
+                pj.append(j)
+                li.append(i)
+        return cls.from_triples(m, len(columns), li, pj)
+
+    @classmethod
+    def from_triples(cls, m, n, legs, pairings):
+        """Builds the matrix from parallel (leg_index, pairing_index) sequences such as incidence.csv."""
+        col_ptr, row_idx = _compress(n, pairings, legs)
+        return cls(m, n, col_ptr, row_idx)
+
+    @property
+    def nnz(self):
+        return len(self.row_idx)
+
+    def column(self, j):
+        """Legs covered by pairing j."""
+        return self.row_idx[self.col_ptr[j]:self.col_ptr[j + 1]]
+
+    def row(self, i):
+        """Pairings covering leg i."""
+        return self.col_idx[self.row_ptr[i]:self.row_ptr[i + 1]]
+
+    def row_counts(self):
+        """Number of pairings covering each leg."""
+        rp = self.row_ptr
+        return [rp[i + 1] - rp[i] for i in range(self.m)]
+
+
+class _LPMaster:
+    """
+    LP relaxation of the restricted master problem used by column generation.
+
+    Each leg row gets an artificial column priced at `artificial_cost` so the relaxation stays feasible while the pool
+    is still too small to partition the legs. Rows flagged in `cover_rows` are covering rows (>= 1) instead of
+    partitioning rows. With HiGHS the model is kept alive between rounds and new columns are
+    appended, so every re-solve starts from the previous basis; the PuLP path rebuilds the LP each round.
+    """
+
+    def __init__(self, m, columns, costs, artificial_cost, backend, cover_rows=None):
+        self.m = m
+        self.cover_rows = cover_rows or bytearray(m)
+        self.columns = list(columns)
+        self.costs = list(costs)
+        self.artificial_cost = artificial_cost
+        self.backend = "highs" if backend == "highs" and highspy is not None else "pulp"
+        self.h = None
+        if self.backend == "highs":
+            self.h = highspy.Highs()
+            self.h.setOptionValue("output_flag", False)
+            upper = [highspy.kHighsInf if self.cover_rows[i] else 1.0 for i in range(m)]
+            self.h.addRows(m, [1.0] * m, upper, 0, [0] * m, [], [])
+            self._add_highs_columns([[i] for i in range(m)], [artificial_cost] * m)
+            self._add_highs_columns(self.columns, self.costs)
+
+    def _add_highs_columns(self, columns, costs):
+        starts, index = [], []
+        for col in columns:
+            starts.append(len(index))
+            index.extend(col)
+        self.h.addCols(len(columns), costs, [0.0] * len(columns), [1.0] * len(columns),
+                       len(index), starts, index, [1.0] * len(index))
+
+    def add_columns(self, added):
+        columns = [col for col, _ in added]
+        costs = [cost for _, cost in added]
+        self.columns.extend(columns)
+        self.costs.extend(costs)
+        if self.h is not None:
+            self._add_highs_columns(columns, costs)
+
+    def solve(self):
+        """Returns (LP objective, row duals)."""
+        if self.h is not None:
+            t0 = time.perf_counter()
+            self.h.run()
+            _trace_highs(self.h, "cg.master", t0, rows=self.m, columns=len(self.columns))
+            return self.h.getInfo().objective_function_value, list(self.h.getSolution().row_dual)
+
+        t0 = time.perf_counter()
+        prob = pulp.LpProblem("SPP_master", pulp.LpMinimize)
+        x = [pulp.LpVariable(f"x_{j}", 0, 1) for j in range(len(self.columns))]
+        art = [pulp.LpVariable(f"art_{i}", 0, 1) for i in range(self.m)]
+        prob += pulp.LpAffineExpression(list(zip(x, self.costs)) + [(v, self.artificial_cost) for v in art])
+        rows = [[(art[i], 1)] for i in range(self.m)]
+        for j, col in enumerate(self.columns):
+            for i in col:
+                rows[i].append((x[j], 1))
+        for i in range(self.m):
+            sense = pulp.LpConstraintGE if self.cover_rows[i] else pulp.LpConstraintEQ
+            prob += pulp.LpConstraint(pulp.LpAffineExpression(rows[i]), sense, f"leg_{i}", 1)
+        prob.solve(pulp.PULP_CBC_CMD(msg=0))
+        trace.record("cg.master.solve", t0, time.perf_counter(), rows=self.m, columns=len(self.columns))
+        return pulp.value(prob.objective), [prob.constraints[f"leg_{i}"].pi or 0.0 for i in range(self.m)]
+
+    def solve_integer(self, time_limit=None, start=None):
+        """
+        HiGHS only: turns the live master into the integer SPP (artificial columns fixed to 0, pool columns binary)
+        and solves it, so branch-and-bound starts from the last LP basis. `start` is an optional list of pool column
+        indices handed to HiGHS as a MIP start. Returns (status, objective, pool column values) like the
+        SPPFromCSV backends.
+        """
+        h, m, n = self.h, self.m, len(self.columns)
+        h.changeColsBounds(m, list(range(m)), [0.0] * m, [0.0] * m)
+        h.changeColsIntegrality(n, list(range(m, m + n)), [highspy.HighsVarType.kInteger] * n)
+        return _run_highs(h, time_limit, start, offset=m, n=n)
+
+
+def _run_highs(h, time_limit, start, offset, n):
+    """Runs a HiGHS MIP (optionally time-limited and warm-started) whose pool columns are offset..offset+n-1."""
+    if time_limit is not None:
+        h.setOptionValue("time_limit", float(time_limit))
+    if start:
+        chosen = set(start)
+        sol = highspy.HighsSolution()
+        sol.col_value = [0.0] * offset + [1.0 if j in chosen else 0.0 for j in range(n)]
+        h.setSolution(sol)
+    t0 = time.perf_counter()
+    h.run()
+    _trace_highs(h, "spp.highs", t0, columns=n)
+
+    model_status = h.getModelStatus()
+    if model_status == highspy.HighsModelStatus.kOptimal:
+        status = "Optimal"
+    elif model_status == highspy.HighsModelStatus.kInfeasible:
+        return "Infeasible", None, None
+    elif h.getInfo().primal_solution_status == highspy.SolutionStatus.kSolutionStatusFeasible:
+        status = "Feasible"                # stopped early (time limit) with an integer solution
+    else:
+        return h.modelStatusToString(model_status), None, None
+    return status, h.getInfo().objective_function_value, list(h.getSolution().col_value)[offset:offset + n]
+
+
+def _trace_highs(h, name, t0, **args):
+    """Reports one HiGHS run to pipeline_trace: a `<name>.solve` slice plus simplex iterations and B&B nodes."""
+    if not trace.enabled():
+        return
+    info = h.getInfo()
+    iterations = getattr(info, "simplex_iteration_count", 0)
+    nodes = getattr(info, "mip_node_count", 0)
+    trace.record(f"{name}.solve", t0, time.perf_counter(), iterations=iterations, nodes=nodes, **args)
+    trace.count(f"{name}.lp_iterations", max(0, iterations))
+    trace.count(f"{name}.mip_nodes", max(0, nodes))
 
 
 class SPPFromCSV:
@@ -38,10 +267,19 @@ class SPPFromCSV:
         self.pairings = []           # dict list: {pairing_index, pairing_id, base, legs}
         self.legs = []               # list of leg_id strings
         self.leg_to_index = {}       # map leg_id -> leg_index
+        self.leg_dict = LegDictionary()  # shared interning of leg tokens -> integer codes
+        self.row_of_code = {}        # leg code -> leg_index
         self.n = 0                   # number of pairings
         self.m = 0                   # number of legs
         self.c = []                  # pairing costs
-        self.a = None                # incidence matrix (m x n)
+        self.a = None                # SparseIncidence (m x n, CSC + CSR)
+        self.timings = {}            # stage -> seconds for the last solve
+        self.lower_bound = None      # Lagrangian lower bound of the last heuristic solve
+        self.solution = []           # pairing indices selected by the last solve
+        self._highs = None           # live HiGHS model of the last backend="highs" solve (for warm re-solves)
+        self.exact_deadheads = False  # True: deadhead (TDH_) rows must be covered exactly once like flown legs
+        self.instance = None         # CompiledInstance of load_compiled, for coverage_report
+        self.coverage = None         # coverage_report of the last solve_rolling result
 
     # ============================================================
     #  LOAD legs.csv
@@ -74,6 +312,7 @@ class SPPFromCSV:
 
         self.legs = leg_rows
         self.leg_to_index = {leg: i for i, leg in enumerate(self.legs)}
+        self.row_of_code = {self.leg_dict.code(leg): i for i, leg in enumerate(self.legs)}
         self.m = len(self.legs)
 
         print(f"Loaded {self.m} legs")
@@ -135,7 +374,8 @@ class SPPFromCSV:
                     "pairing_index": pairing_index,
                     "pairing_id": pairing_id,
                     "base": base,
-                    "legs": legs
+                    "legs": legs,
+                    "codes": self.leg_dict.encode(legs)
                 })
 
         # sort and normalize indices
@@ -147,6 +387,82 @@ class SPPFromCSV:
         self.n = len(pairings)
         print(f"Loaded {self.n} pairings")
 
+    # ============================================================
+    #  LOAD from a compiled instance (instance_store.py)
+    # ============================================================
+    def load_compiled(self, instance):
+        """
+        Loads legs and pairings from an instance_store.CompiledInstance instead of legs.csv/pairings.csv.
+        The instance's leg dictionary is adopted, so pairing codes come straight from the mapped file; legs are
+        indexed in order of first appearance over the pairings, matching the Phase 0 legs.csv ordering, and the
+        incidence matrix is built from the codes.
+        """
+        self.instance = instance
+        self.leg_dict = instance.leg_dict
+        self.legs = []
+        self.leg_to_index = {}
+        self.row_of_code = {}
+        self.pairings = []
+
+        for j in range(instance.n_pairings):
+            codes = list(instance.pairing(j))
+            names = self.leg_dict.decode(codes)
+            for code, leg in zip(codes, names):
+                if code not in self.row_of_code:
+                    self.row_of_code[code] = len(self.legs)
+                    self.leg_to_index[leg] = len(self.legs)
+                    self.legs.append(leg)
+            self.pairings.append({
+                "pairing_index": j,
+                "pairing_id": str(instance.pair_num[j]),
+                "base": instance.airports[instance.pair_base[j]],
+                "legs": names,
+                "codes": codes,
+            })
+
+        self.m = len(self.legs)
+        self.n = len(self.pairings)
+        print(f"Loaded {self.m} legs and {self.n} pairings from {instance.path}")
+        self.infer_incidence()
+
+    # ============================================================
+    #  LOAD a Phase 3 pool file (pool_store.py)
+    # ============================================================
+    @trace.traced("spp.load_pool")
+    def load_pool(self, path):
+        """
+        Streams a Phase 3 pool file chunk by chunk and loads its pairings and costs, so the pool is never held as a
+        list of JSON dicts. Pool leg codes are translated to this solver's leg dictionary by name (legs already loaded
+        from legs.csv keep their rows; unseen legs are added as in infer_incidence), then the incidence is built.
+        """
+        from pool_store import PoolReader
+
+        reader = PoolReader(path)
+        translate = {}
+        self.pairings = []
+        self.c = []
+        for chunk in reader.chunks():
+            for k in range(len(chunk)):
+                codes = []
+                for code in chunk.pairing(k):
+                    own = translate.get(code)
+                    if own is None:
+                        own = translate[code] = self.leg_dict.code(reader.legs.name(code))
+                    codes.append(own)
+                j = len(self.pairings)
+                self.pairings.append({
+                    "pairing_index": j,
+                    "pairing_id": str(j),
+                    "base": reader.bases[chunk.base_ids[k]],
+                    "legs": self.leg_dict.decode(codes),
+                    "codes": codes,
+                })
+            self.c.extend(chunk.costs)
+
+        self.n = len(self.pairings)
+        print(f"Loaded {self.n} pairings from {path}")
+        self.infer_incidence()
+
     # ============================================================
     #  LOAD incidence.csv (optional)
     # ============================================================
@@ -161,7 +477,8 @@ class SPPFromCSV:
             print("No incidence.csv found. Will infer from pairings instead.")
             return False
 
-        self.a = [[0] * self.n for _ in range(self.m)]
+        legs = array("I")
+        pairings = array("I")
 
         with open(path, newline="", encoding="utf-8-sig") as f:
             reader = csv.DictReader(f)
@@ -180,9 +497,11 @@ class SPPFromCSV:
                 li = int(row[li_col])
                 pj = int(row[pj_col])
                 if 0 <= li < self.m and 0 <= pj < self.n:
-                    self.a[li][pj] = 1
+                    legs.append(li)
+                    pairings.append(pj)
 
-        print("Loaded incidence matrix from incidence.csv")
+        self.a = SparseIncidence.from_triples(self.m, self.n, legs, pairings)
+        print(f"Loaded incidence matrix from incidence.csv ({self.a.nnz} nonzeros)")
         return True
 
     # ============================================================
@@ -195,24 +514,28 @@ class SPPFromCSV:
         model feasibility rather than failing early.
         """
         print("Inferring incidence from pairings...")
+        t0 = time.perf_counter()
+        row_of_code = self.row_of_code
         # ensure all legs exist
         for p in self.pairings:
-            for leg in p["legs"]:
-                if leg not in self.leg_to_index:
+            if "codes" not in p:
+                p["codes"] = self.leg_dict.encode(p["legs"])
+            for code, leg in zip(p["codes"], p["legs"]):
+                if code not in row_of_code:
                     print(f"WARNING: leg {leg} not in legs.csv — adding it.")
+                    row_of_code[code] = self.m
                     self.leg_to_index[leg] = self.m
                     self.legs.append(leg)
                     self.m += 1
 
-        # build matrix
-        self.a = [[0] * self.n for _ in range(self.m)]
-        for p in self.pairings:
-            pj = p["pairing_index"]
-            for leg in p["legs"]:
-                li = self.leg_to_index[leg]
-                self.a[li][pj] = 1
+        # build matrix (pairings are already normalized to pairing_index == position)
+        self.a = SparseIncidence.from_columns(
+            self.m, [[row_of_code[code] for code in p["codes"]] for p in self.pairings]
+        )
 
-        print("Incidence matrix constructed.")
+        trace.record("spp.infer_incidence", t0, time.perf_counter(), rows=self.m, columns=self.n)
+        trace.count("spp.nonzeros", self.a.nnz)
+        print(f"Incidence matrix constructed ({self.a.nnz} nonzeros).")
 
     # ============================================================
     #  LOAD costs.csv (optional)
@@ -267,43 +590,223 @@ class SPPFromCSV:
     # ============================================================
     #  Solve Set-Partitioning Problem
     # ============================================================
-    def solve_spp(self):
+    def cover_rows(self):
         """
-        Builds and solves the Set Partitioning Problem using a binary linear program. Pulp in this case.
-        The objective minimizes total pairing cost subject to exact coverage of every leg. Solution parsing is 
-        restricted to optimal solver outcomes to avoid propagating infeasible or partial results.
+        Flags of the rows that only need covering at least once: deadhead (TDH_) legs, on which several crews may
+        ride as passengers (the shipped initial solutions do this), unless `exact_deadheads` is set.
+        """
+        flags = bytearray(self.m)
+        if not self.exact_deadheads:
+            for code, i in self.row_of_code.items():
+                if is_deadhead(code):
+                    flags[i] = 1
+        return flags
+
+    def find_incumbent(self, reference=None):
+        """
+        Locates a known feasible partition inside the pool, to be used as a warm start.
+
+        With `reference` (an iterable of leg-token lists, e.g. the pairings of initialSolution.in) each reference
+        pairing is matched to the pool column covering the same legs. Without it, columns are taken greedily in pool
+        order while they stay disjoint, which recovers the initial-solution pairings Phase 3 always places at the
+        front of a pool. Returns the pairing indices if they are feasible (every leg covered exactly once, deadhead
+        rows at least once; see cover_rows), otherwise None.
         """
         if self.a is None:
             self.infer_incidence()
+        cover = self.cover_rows()
+
+        chosen = []
+        if reference is not None:
+            by_rows = {}
+            for j in range(self.n):
+                by_rows.setdefault(tuple(self.a.column(j)), j)
+            for legs in reference:
+                rows = set()
+                for token in legs:
+                    i = self.row_of_code.get(self.leg_dict.lookup(token))
+                    if i is None:
+                        return None
+                    rows.add(i)
+                j = by_rows.get(tuple(sorted(rows)))
+                if j is None:
+                    return None
+                chosen.append(j)
+        else:
+            covered = bytearray(self.m)
+            for j in range(self.n):
+                col = self.a.column(j)
+                if not all(covered[i] for i in col) and not any(covered[i] and not cover[i] for i in col):
+                    for i in col:
+                        covered[i] = 1
+                    chosen.append(j)
+
+        return chosen if self.is_feasible(chosen) else None
+
+    def is_feasible(self, chosen):
+        """True when the pairings `chosen` cover every leg exactly once (deadhead rows at least once)."""
+        cover = self.cover_rows()
+        counts = [0] * self.m
+        for j in chosen:
+            for i in self.a.column(j):
+                counts[i] += 1
+        return all(k == 1 or (k > 1 and cover[i]) for i, k in enumerate(counts))
+
+    def coverage_report(self, instance, selected=None):
+        """
+        data_coverage_check report of the selected pairings (default: the last solve) against a compiled instance:
+        missing and duplicated flight legs, base mismatches and unknown leg ids, as a JSON-serializable dict.
+        """
+        from data_coverage_check import validate_pairings
 
+        chosen = self.solution if selected is None else selected
+        return validate_pairings(instance, [self.pairings[j] for j in chosen], source="solve_spp")
+
+    def leg_duals(self, backend="pulp", time_limit=5.0, artificial_cost=1e6):
+        """
+        Dual prices of the leg rows over the current pool, by leg name: the LP relaxation duals (backend "pulp" or
+        "highs", one artificial column per leg as in column generation) or, with backend="heuristic", the Lagrangian
+        multipliers of the best bound found in `time_limit` seconds. Phase 3's guided mode
+        (generate_sample(mode="guided", duals=...)) samples toward the legs these price highly.
+        """
+        if self.a is None:
+            self.infer_incidence()
         if not self.c or len(self.c) != self.n:
             self.load_costs_csv()
+        if backend == "heuristic":
+            heuristic = SPPHeuristic(self.a, self.c, self.cover_rows())
+            heuristic.solve(time_limit=time_limit)
+            duals = heuristic.multipliers
+        else:
+            columns = [list(self.a.column(j)) for j in range(self.n)]
+            _, duals = _LPMaster(self.m, columns, self.c, artificial_cost, backend, self.cover_rows()).solve()
+        return {self.legs[i]: duals[i] for i in range(self.m)}
 
-        prob = pulp.LpProblem("SPP", pulp.LpMinimize)
-        x = [pulp.LpVariable(f"x_{j}", cat="Binary") for j in range(self.n)]
+    def presolve(self):
+        """Runs the SPP presolve (spp_presolve.py) over the current pool; returns its PresolveResult."""
+        if self.a is None:
+            self.infer_incidence()
+        if not self.c or len(self.c) != self.n:
+            self.load_costs_csv()
+        with trace.span("spp.presolve", rows=self.m, columns=self.n):
+            result = spp_presolve.presolve(self.m, [self.a.column(j) for j in range(self.n)], self.c,
+                                           self.cover_rows())
+        print(result.report())
+        return result
 
-        # objective
-        prob += pulp.lpSum(self.c[j] * x[j] for j in range(self.n))
+    def subproblem(self, rows, columns):
+        """
+        Standalone SPPFromCSV over a subset of rows and columns (original indices), sharing this solver's leg
+        dictionary; column k of the subproblem is pairing `columns[k]`. Legs outside `rows` are dropped from the
+        subproblem's columns.
+        """
+        sub = SPPFromCSV(self.instance_folder)
+        sub.leg_dict = self.leg_dict
+        sub.exact_deadheads = self.exact_deadheads
+        local = {i: k for k, i in enumerate(rows)}
+        sub.legs = [self.legs[i] for i in rows]
+        sub.leg_to_index = {leg: k for k, leg in enumerate(sub.legs)}
+        sub.row_of_code = {code: local[i] for code, i in self.row_of_code.items() if i in local}
+        sub.pairings = [dict(self.pairings[j], pairing_index=k) for k, j in enumerate(columns)
+                        if j < len(self.pairings)]
+        sub.c = [self.c[j] for j in columns]
+        sub.a = SparseIncidence.from_columns(
+            len(rows), [[local[i] for i in self.a.column(j) if i in local] for j in columns])
+        sub.m, sub.n = len(rows), len(columns)
+        return sub
+
+    def solve_spp(self, backend="pulp", time_limit=None, incumbent="auto", master=None, presolve=False,
+                  warm_model=False, diagnose=True):
+        """
+        Builds and solves the Set Partitioning Problem using a binary linear program.
+        The objective minimizes total pairing cost subject to exact coverage of every leg (deadhead rows: at least one
+        cover, see cover_rows). Solution parsing is restricted to solver outcomes that carry an integer-feasible
+        solution to avoid propagating infeasible or partial results.
+
+        backend="pulp" builds the model through PuLP and solves it with CBC. backend="highs" hands the sparse incidence,
+        cost vector and binary bounds straight to HiGHS in memory (no model file is written); it falls back to PuLP when
+        highspy is not installed. Model build and solve times are reported separately and kept in `self.timings`.
+        backend="heuristic" runs the Lagrangian + greedy + local-search heuristic (spp_heuristic.py) for `time_limit`
+        seconds (default 10) and returns the best partition found, with the Lagrangian bound in `self.lower_bound`.
+
+        `incumbent` is a list of pairing indices forming a feasible partition, None, or "auto" (find_incumbent()). It is
+        passed to the solver as a MIP start, and when `time_limit` (seconds) stops the search the better of the
+        solver's solution and the incumbent is returned, so a time-limited run is never worse than the initial
+        solution. `master` is the _LPMaster of a column-generation run over exactly this pool; with HiGHS the integer
+        solve then continues from its LP basis instead of building a new model.
+
+        With `presolve=True` the pool is first reduced by spp_presolve (forced, conflicting, duplicate and dominated
+        columns, dominated rows); each independent component of the reduced problem is solved as its own SPP (with
+        `time_limit` per component) and the combined solution mapped back to original indices.
+        With `warm_model=True` and HiGHS, the model kept from the previous solve (patched by apply_leg_changes) is
+        re-run, so the search restarts from its last basis and solution. Without a warm start and with `diagnose`, the
+        pool is first checked for leg subsets it cannot partition (find_conflicts); those are reported and no solve is
+        attempted. Solves of subproblems (presolve components, decomposition blocks, rolling windows) pass
+        diagnose=False: the check runs once on the whole problem, and a failed subproblem solve is still diagnosed.
+        """
+        if self.a is None:
+            self.infer_incidence()
 
-        # constraints: each leg exactly once
-        for i in range(self.m):
-            prob += pulp.lpSum(self.a[i][j] * x[j] for j in range(self.n)) == 1
+        if not self.c or len(self.c) != self.n:
+            self.load_costs_csv()
 
-        print("Solving...")
-        prob.solve(pulp.PULP_CBC_CMD(msg=0))
+        if backend == "highs" and highspy is None:
+            print("highspy not installed — falling back to the PuLP/CBC backend.")
+            backend = "pulp"
+
+        start = self.find_incumbent() if incumbent == "auto" else incumbent
+        if start:
+            print(f"Warm start: {len(start)} pairings, objective {sum(self.c[j] for j in start)}")
+        elif diagnose:
+            # without a known partition, rule out structurally infeasible pools before paying for the solve
+            conflicts = self.find_conflicts(time_limit=30)
+            if conflicts:
+                print("Pool cannot partition the legs. No solution available.")
+                self.diagnose_infeasibility(conflicts)
+                return []
+
+        if presolve:
+            return self._solve_presolved(backend, time_limit, start)
+
+        if backend == "highs" and master is not None and master.h is not None:
+            t0 = time.perf_counter()
+            print("Solving...")
+            status, obj_value, values = master.solve_integer(time_limit, start)
+            self.timings = {"build": 0.0, "solve": time.perf_counter() - t0}
+        elif backend == "highs" and warm_model and self._highs is not None:
+            t0 = time.perf_counter()
+            print("Solving (warm model)...")
+            status, obj_value, values = _run_highs(self._highs, time_limit, start, offset=0, n=self.n)
+            self.timings = {"build": 0.0, "solve": time.perf_counter() - t0}
+        elif backend == "highs":
+            status, obj_value, values = self._solve_highs(time_limit, start)
+        elif backend == "pulp":
+            status, obj_value, values = self._solve_pulp(time_limit, start)
+        elif backend == "heuristic":
+            status, obj_value, values = self._solve_heuristic(time_limit, start)
+        else:
+            raise ValueError(f"Unknown backend {backend}")
+
+        if start:
+            start_obj = sum(self.c[j] for j in start)
+            if values is None or obj_value > start_obj + 1e-9:
+                chosen = set(start)
+                status, obj_value = "Incumbent", start_obj
+                values = [1.0 if j in chosen else 0.0 for j in range(self.n)]
 
-        status = pulp.LpStatus[prob.status]
         print("Status:", status)
+        print(f"Model build: {self.timings['build']:.2f}s | Solve: {self.timings['solve']:.2f}s")
 
-        # FIXED: Only process solution if optimal
-        if status == "Optimal":
-            obj_value = pulp.value(prob.objective)
+        # FIXED: Only process solution if integer feasible (optimal, time-limited, or the kept incumbent)
+        if status in ("Optimal", "Feasible", "Incumbent"):
             print("Objective value:", obj_value)
+            if status != "Optimal":
+                print("Note: optimality not proven.")
 
-            solution = [int(pulp.value(x[j])) for j in range(self.n)]
-            selected = [j for j, val in enumerate(solution) if val == 1]
+            selected = [j for j, val in enumerate(values) if round(val) == 1]
 
             print(f"\nSelected {len(selected)} pairings out of {self.n}")
+            self.solution = selected
             return selected
         else:
             print("Problem is not optimal. No solution available.")
@@ -311,21 +814,676 @@ class SPPFromCSV:
             self.diagnose_infeasibility()
             return []
 
+    def _solve_presolved(self, backend, time_limit, start):
+        reduced = self.presolve()
+        if reduced.infeasible:
+            print("Problem is not optimal. No solution available.")
+            print("\nDiagnosing infeasibility...")
+            self.diagnose_infeasibility()
+            return []
+        if not reduced.columns:
+            self.timings = {"build": 0.0, "solve": 0.0}
+            print(f"Presolve solved the problem. Objective value: {reduced.fixed_cost}")
+            self.solution = reduced.fixed
+            return reduced.fixed
+
+        # independent components share no legs: each is its own SPP, and their solutions simply combine
+        mapped = reduced.map_start(start) if start else None
+        start_cols = None if mapped is None else {reduced.columns[k] for k in mapped}
+        position = {j: k for k, j in enumerate(reduced.columns)}
+        self.timings = {"build": 0.0, "solve": 0.0}
+        chosen = []
+        print(f"Solving {len(reduced.components)} independent components separately")
+        for rows, cols in sorted(reduced.components, key=lambda rc: -len(rc[1])):
+            sub = self.subproblem(rows, cols)
+            local = None if start_cols is None else [k for k, j in enumerate(cols) if j in start_cols]
+            picked = sub.solve_spp(backend=backend, time_limit=time_limit, incumbent=local, diagnose=False)
+            for key in self.timings:
+                self.timings[key] += sub.timings.get(key, 0.0)
+            if not picked:
+                print(f"Component with {len(rows)} legs / {len(cols)} pairings has no solution.")
+                return []
+            chosen.extend(position[cols[k]] for k in picked)
+        selected = reduced.restore(chosen)
+        print(f"Selected {len(selected)} pairings out of {self.n} (objective {sum(self.c[j] for j in selected)})")
+        self.solution = selected
+        return selected
+
+    def _solve_heuristic(self, time_limit=None, start=None):
+        """Heuristic path: anytime primal search on the sparse incidence; "Optimal" only when the bound closes the gap."""
+        t0 = time.perf_counter()
+        heuristic = SPPHeuristic(self.a, self.c, self.cover_rows())
+        t1 = time.perf_counter()
+        print("Solving...")
+        sol, obj, self.lower_bound = heuristic.solve(time_limit=10.0 if time_limit is None else time_limit,
+                                                     start=start)
+        t2 = time.perf_counter()
+        self.timings = {"build": t1 - t0, "solve": t2 - t1}
+        trace.record("spp.heuristic.build", t0, t1, rows=self.m, columns=self.n)
+        trace.record("spp.heuristic.solve", t1, t2)
+        print(f"Lagrangian lower bound: {self.lower_bound:.2f}")
+        if sol is None:
+            return "Not Solved", None, None
+        gap = (obj - self.lower_bound) / max(1.0, abs(obj))
+        print(f"Heuristic objective {obj:.2f}, gap {100 * gap:.2f}%")
+        chosen = set(sol)
+        return ("Optimal" if gap <= 1e-6 else "Feasible"), obj, [1.0 if j in chosen else 0.0 for j in range(self.n)]
+
+    def _solve_pulp(self, time_limit=None, start=None):
+        """
+        PuLP/CBC path. Expressions are assembled from the sparse rows as coefficient lists, so the work is proportional
+        to the nonzeros rather than to m x n; PuLP still serializes the model for the CBC executable. A `start`
+        partition is written as initial values and passed to CBC with warmStart.
+        """
+        t0 = time.perf_counter()
+        prob = pulp.LpProblem("SPP", pulp.LpMinimize)
+        x = [pulp.LpVariable(f"x_{j}", cat="Binary") for j in range(self.n)]
+
+        # objective
+        prob += pulp.LpAffineExpression(list(zip(x, self.c)))
+
+        # constraints: each leg exactly once (deadhead rows at least once)
+        cover = self.cover_rows()
+        for i in range(self.m):
+            expr = pulp.LpAffineExpression([(x[j], 1) for j in self.a.row(i)])
+            sense = pulp.LpConstraintGE if cover[i] else pulp.LpConstraintEQ
+            prob += pulp.LpConstraint(expr, sense, f"leg_{i}", 1)
+        if start:
+            chosen = set(start)
+            for j, v in enumerate(x):
+                v.setInitialValue(1 if j in chosen else 0)
+        t1 = time.perf_counter()
+
+        print("Solving...")
+        prob.solve(pulp.PULP_CBC_CMD(msg=0, warmStart=bool(start), timeLimit=time_limit))
+        t2 = time.perf_counter()
+        self.timings = {"build": t1 - t0, "solve": t2 - t1}
+        trace.record("spp.pulp.build", t0, t1, rows=self.m, columns=self.n, nonzeros=self.a.nnz)
+        trace.record("spp.pulp.solve", t1, t2, status=prob.status)
+
+        status = pulp.LpStatus[prob.status]
+        if status != "Optimal":
+            return status, None, None
+        if getattr(prob, "sol_status", pulp.LpSolutionOptimal) == pulp.LpSolutionIntegerFeasible:
+            status = "Feasible"                # CBC stopped at the time limit with an integer solution
+        return status, pulp.value(prob.objective), [pulp.value(v) or 0.0 for v in x]
+
+    def _solve_highs(self, time_limit=None, start=None):
+        """
+        HiGHS path. The CSC arrays of the incidence matrix are passed as the column-wise constraint matrix together with
+        costs, [0, 1] bounds, integrality and the ==1 row bounds; nothing touches disk. A `start` partition is set as
+        the initial MIP solution.
+        """
+        t0 = time.perf_counter()
+        h = highspy.Highs()
+        h.setOptionValue("output_flag", False)
+
+        lp = highspy.HighsLp()
+        lp.num_col_ = self.n
+        lp.num_row_ = self.m
+        lp.col_cost_ = [float(v) for v in self.c]
+        lp.col_lower_ = [0.0] * self.n
+        lp.col_upper_ = [1.0] * self.n
+        lp.row_lower_ = [1.0] * self.m
+        cover = self.cover_rows()
+        lp.row_upper_ = [highspy.kHighsInf if cover[i] else 1.0 for i in range(self.m)]
+        lp.a_matrix_.format_ = highspy.MatrixFormat.kColwise
+        lp.a_matrix_.num_col_ = self.n
+        lp.a_matrix_.num_row_ = self.m
+        lp.a_matrix_.start_ = self.a.col_ptr
+        lp.a_matrix_.index_ = self.a.row_idx
+        lp.a_matrix_.value_ = [1.0] * self.a.nnz
+        lp.integrality_ = [highspy.HighsVarType.kInteger] * self.n
+        h.passModel(lp)
+        t1 = time.perf_counter()
+        trace.record("spp.highs.build", t0, t1, rows=self.m, columns=self.n, nonzeros=self.a.nnz)
+
+        print("Solving...")
+        result = _run_highs(h, time_limit, start, offset=0, n=self.n)
+        self._highs = h
+        t2 = time.perf_counter()
+        self.timings = {"build": t1 - t0, "solve": t2 - t1}
+        return result
+
+    # ============================================================
+    #  Column generation
+    # ============================================================
+    def solve_column_generation(self, network, max_rounds=50, columns_per_round=200, backend="pulp",
+                                leg_cost=1.0, fixed_cost=0.0, artificial_cost=1e6, time_limit=None):
+        """
+        Iterative alternative to handing a huge pre-generated pool to solve_spp.
+
+        The loaded pairings form the restricted master. Each round solves its LP relaxation (one artificial column per
+        leg keeps it feasible), reads the leg duals and asks `network` (a flight_network.FlightNetwork over the
+        instance's day files and bases) for pairings with negative reduced cost. Rounds stop when pricing finds
+        nothing or after `max_rounds`; the integer SPP is then solved once over the original plus generated columns,
+        warm-started from the loaded pairings when they partition the legs and, with HiGHS, from the master's basis.
+        Generated pairings cost `fixed_cost + leg_cost * n_legs`, which with the defaults matches the
+        legs-per-pairing proxy used when costs.csv is missing.
+        """
+        if self.a is None:
+            self.infer_incidence()
+        if not self.c or len(self.c) != self.n:
+            self.load_costs_csv()
+        start = self.find_incumbent()
+
+        # master rows that the flight network can price (TDH_/unknown legs stay covered by the given pairings only)
+        row_of_leg = {}
+        for i, leg in enumerate(self.legs):
+            k = network.legs.index.get(leg)
+            if k is not None:
+                row_of_leg[k] = i
+
+        columns = [list(self.a.column(j)) for j in range(self.n)]
+        costs = list(self.c)
+        seen = {tuple(col) for col in columns}
+        master = _LPMaster(self.m, columns, costs, artificial_cost, backend, self.cover_rows())
+        n_generated = 0
+
+        for rnd in range(1, max_rounds + 1):
+            obj, duals = master.solve()
+            with trace.span("cg.price", round=rnd):
+                new_columns = network.price(
+                    {k: duals[i] for k, i in row_of_leg.items()},
+                    leg_cost=leg_cost, fixed_cost=fixed_cost, max_columns=columns_per_round,
+                )
+
+            added = []
+            for rc, base, path in new_columns:
+                col = [row_of_leg[k] for k in path]
+                if tuple(col) in seen:
+                    continue
+                seen.add(tuple(col))
+                added.append((col, fixed_cost + leg_cost * len(col)))
+                leg_names = [self.legs[i] for i in col]
+                self.pairings.append({
+                    "pairing_index": self.n + n_generated,
+                    "pairing_id": f"CG_{n_generated}",
+                    "base": base,
+                    "legs": leg_names,
+                    "codes": self.leg_dict.encode(leg_names),
+                })
+                n_generated += 1
+
+            trace.count("cg.columns", len(added))
+            trace.count("cg.duplicates", len(new_columns) - len(added))
+            print(f"CG round {rnd}: LP objective {obj:.2f}, {len(added)} new columns")
+            if not added:
+                break
+            master.add_columns(added)
+            columns.extend(col for col, _ in added)
+            costs.extend(cost for _, cost in added)
+
+        print(f"Column generation added {n_generated} pairings; solving the integer master...")
+        self.n = len(columns)
+        self.c = costs
+        self.a = SparseIncidence.from_columns(self.m, columns)
+        return self.solve_spp(backend=backend, time_limit=time_limit, incumbent=start, master=master)
+
+    # ============================================================
+    #  Incremental update after leg edits
+    # ============================================================
+    def apply_leg_changes(self, diff, network, cost_fn=None, initial=None):
+        """
+        Patches the loaded pool for edited legs instead of rebuilding it (see incremental_resolve.py).
+
+        `diff` lists the retimed/re-routed (`changed`), cancelled (`removed`) and new (`added`) leg names and `network`
+        is the FlightNetwork of the edited instance. Pairings flying a cancelled leg, or whose edited legs break a
+        connection/duty/pairing rule (FlightNetwork.is_legal), are removed. Pairings of the initial solution (`initial`,
+        their leg-name sequences) are taken as given and only removed over a cancelled or unknown leg, since a few
+        shipped pairings break the network's default limits (see flight_network). Other pairings touching edited legs
+        are re-costed with `cost_fn(list of pairing dicts) -> costs`, and keep their current cost without one (the
+        pool's costs are on the scale of the loaded cost vector, which no fixed proxy matches). Rows of cancelled legs
+        are dropped and new legs get rows at the end. The cost vector, pairing list and incidence are updated together:
+        the Python-side SparseIncidence is rebuilt from the kept columns (one O(nnz) pass), while the live HiGHS model
+        (if any) is patched in place, which is what saves the re-solve its model build. The previous solution, minus
+        removed pairings, is returned when it is still feasible, so it can seed the re-solve as incumbent.
+        """
+        affected = set(diff.changed) | set(diff.removed)
+        removed = set(diff.removed)
+        names = self.leg_dict.names
+        exempt = {tuple(legs) for legs in initial} if initial else set()
+
+        dead, touched = [], []
+        for j, p in enumerate(self.pairings):
+            bare = [names[leg_id(code)] for code in p["codes"]]
+            if not affected.intersection(bare):
+                continue
+            path = [network.legs.index.get(leg) for leg in bare]
+            if removed.intersection(bare) or None in path or (
+                    tuple(p["legs"]) not in exempt and not network.is_legal(path, p["base"])):
+                dead.append(j)
+            else:
+                touched.append(j)
+
+        drop_rows = [i for i, leg in enumerate(self.legs) if names[leg_id(self.leg_dict.lookup(leg))] in removed]
+        new_legs = [leg for leg in diff.added if self.leg_dict.lookup(leg) not in self.row_of_code]
+
+        # compact columns and rows, keeping relative order (same renumbering as HiGHS deleteCols/deleteRows)
+        dead_set, drop_set = set(dead), set(drop_rows)
+        keep_cols = [j for j in range(self.n) if j not in dead_set]
+        keep_rows = [i for i in range(self.m) if i not in drop_set]
+        new_col = {j: k for k, j in enumerate(keep_cols)}
+        new_row = {i: k for k, i in enumerate(keep_rows)}
+
+        code_of_row = {i: code for code, i in self.row_of_code.items()}
+        self.legs = [self.legs[i] for i in keep_rows] + new_legs
+        self.leg_to_index = {leg: k for k, leg in enumerate(self.legs)}
+        self.row_of_code = {code_of_row[i]: k for i, k in new_row.items() if i in code_of_row}
+        for leg in new_legs:
+            self.row_of_code[self.leg_dict.code(leg)] = self.leg_to_index[leg]
+
+        columns = [[new_row[i] for i in self.a.column(j)] for j in keep_cols]
+        self.pairings = [dict(self.pairings[j], pairing_index=k) for k, j in enumerate(keep_cols)]
+        self.c = [self.c[j] for j in keep_cols]
+        recost = [new_col[j] for j in touched] if cost_fn else []
+        if recost:
+            for k, cost in zip(recost, cost_fn([self.pairings[k] for k in recost])):
+                self.c[k] = float(cost)
+        self.m, self.n = len(self.legs), len(keep_cols)
+        self.a = SparseIncidence.from_columns(self.m, columns)
+
+        if self._highs is not None:
+            h = self._highs
+            if dead:
+                h.deleteCols(len(dead), dead)
+            if drop_rows:
+                h.deleteRows(len(drop_rows), drop_rows)
+            if recost:
+                h.changeColsCost(len(recost), recost, [self.c[k] for k in recost])
+            if new_legs:
+                h.addRows(len(new_legs), [1.0] * len(new_legs), [1.0] * len(new_legs), 0,
+                          [0] * len(new_legs), [], [])
+
+        previous = [new_col[j] for j in self.solution if j in new_col]
+        uncovered = sum(1 for k in self.a.row_counts() if k == 0)
+        print(f"Leg changes: {len(diff.changed)} edited, {len(diff.removed)} cancelled, {len(diff.added)} new | "
+              f"removed {len(dead)} pairings, re-costed {len(recost)}, dropped {len(drop_rows)} rows, "
+              f"{uncovered} legs now uncovered")
+        self.solution = previous if self.is_feasible(previous) else []
+        return self.solution
+
+    # ============================================================
+    #  Decomposition by crew base
+    # ============================================================
+    def solve_decomposed(self, backend="pulp", n_threads=None, max_iters=15, time_limit=None, step=2.0):
+        """
+        Per-base decomposition of the SPP, with the blocks solved in parallel on a thread pool.
+
+        Pairings are grouped by base. A leg covered only by pairings of one base belongs to that base's block; legs
+        covered by several bases are shared. Without shared legs the blocks are independent and their solutions are
+        simply combined. Otherwise the shared rows are relaxed with Lagrangian multipliers: every round each block
+        solves its own SPP with costs reduced by the multipliers of the shared legs its pairings cover, the sum of
+        block objectives plus the multipliers gives a lower bound (valid when blocks solve to optimality), and the
+        multipliers follow a Polyak subgradient step towards the best known objective. Finally a small master SPP over
+        the columns chosen by any block in any round, plus the incumbent, is solved exactly over all legs to produce a
+        consistent partition. `time_limit` applies to every block and to the master solve.
+        """
+        if self.a is None:
+            self.infer_incidence()
+        if not self.c or len(self.c) != self.n:
+            self.load_costs_csv()
+
+        t0 = time.perf_counter()
+        cover = self.cover_rows()
+        start = self.find_incumbent()
+        if not start:
+            # once for the whole pool; the block and master solves below skip it
+            conflicts = self.find_conflicts(time_limit=30)
+            if conflicts:
+                print("Pool cannot partition the legs. No solution available.")
+                self.diagnose_infeasibility(conflicts)
+                return []
+
+        by_base = {}
+        for j in range(self.n):
+            base = self.pairings[j].get("base") if j < len(self.pairings) else None
+            by_base.setdefault(base, []).append(j)
+        block_of_col = {}
+        for k, cols in enumerate(by_base.values()):
+            for j in cols:
+                block_of_col[j] = k
+
+        shared = set()
+        block_rows = [[] for _ in by_base]
+        for i in range(self.m):
+            owners = {block_of_col[j] for j in self.a.row(i)}
+            if len(owners) == 1:
+                block_rows[owners.pop()].append(i)
+            elif owners:
+                shared.add(i)
+        blocks = [(self.subproblem(rows, cols), cols) for rows, cols in zip(block_rows, by_base.values())]
+        print(f"Decomposition: {len(blocks)} base blocks, {len(shared)} shared legs out of {self.m}")
+
+        u = {i: 0.0 for i in shared}
+
+        def solve_block(block):
+            sub, cols = block
+            sub.c = [self.c[j] - sum(u.get(i, 0.0) for i in self.a.column(j)) for j in cols]
+            selected = sub.solve_spp(backend=backend, time_limit=time_limit, incumbent=None, diagnose=False)
+            if not selected and sub.m:
+                return None
+            return sum(sub.c[k] for k in selected), [cols[k] for k in selected]
+
+        best_ub = sum(self.c[j] for j in start) if start else float("inf")
+        best_lb = float("-inf")
+        collected = set(start or [])
+        stalled = 0
+
+        with ThreadPoolExecutor(max_workers=n_threads or os.cpu_count()) as pool:
+            for it in range(1, max_iters + 1):
+                results = list(pool.map(solve_block, blocks))
+                if any(r is None for r in results):
+                    print("A base block is infeasible — no partition exists.")
+                    self.diagnose_infeasibility()
+                    return []
+
+                chosen = [j for _, cols in results for j in cols]
+                collected.update(chosen)
+                lb = sum(z for z, _ in results) + sum(u.values())
+                counts = {i: 0 for i in shared}
+                for j in chosen:
+                    for i in self.a.column(j):
+                        if i in counts:
+                            counts[i] += 1
+                g = {i: 1 - counts[i] for i in shared}
+                violated = sum(1 for i in shared if (g[i] > 0 if cover[i] else g[i] != 0))
+                if not violated:
+                    best_ub = min(best_ub, sum(self.c[j] for j in chosen))
+
+                if lb > best_lb + 1e-9:
+                    best_lb, stalled = lb, 0
+                else:
+                    stalled += 1
+                    if stalled >= 3:
+                        step, stalled = step / 2, 0
+                print(f"Lagrangian round {it}: lower bound {lb:.2f}, best objective {best_ub}, "
+                      f"{violated} shared legs violated")
+
+                if not shared or not violated:
+                    break
+                norm = sum(v * v for i, v in g.items() if not (cover[i] and u[i] <= 0 and v < 0))
+                if norm == 0:
+                    break
+                target = best_ub if best_ub < float("inf") else lb + abs(lb) * 0.05 + 1.0
+                t = step * (target - lb) / norm
+                for i in shared:
+                    u[i] += t * g[i]
+                    if cover[i]:
+                        u[i] = max(0.0, u[i])
+
+        columns = sorted(collected)
+        print(f"Small master over {len(columns)} collected columns (lower bound {best_lb:.2f})...")
+        master = self.subproblem(list(range(self.m)), columns)
+        position = {j: k for k, j in enumerate(columns)}
+        selected = master.solve_spp(backend=backend, time_limit=time_limit,
+                                    incumbent=[position[j] for j in start] if start else None, diagnose=False)
+        self.timings = {"build": 0.0, "solve": time.perf_counter() - t0}
+        if not selected:
+            return []
+        selected = [columns[k] for k in selected]
+        self.solution = selected
+        print(f"Decomposed solve: {len(selected)} pairings, objective {sum(self.c[j] for j in selected)}, "
+              f"{self.timings['solve']:.2f}s")
+        return selected
+
+    # ============================================================
+    #  Rolling horizon over days
+    # ============================================================
+    def solve_rolling(self, window_days=7, commit_days=4, backend="pulp", time_limit=None, n_threads=None,
+                      artificial_cost=1e6, instance=None):
+        """
+        Rolling-horizon solve over the days encoded in the leg ids, for month-long instances whose full SPP is too
+        large to build.
+
+        Each window spans `window_days` days starting at the first open day; its SPP has the still-uncovered legs of
+        those days as rows and, as columns, the pool pairings that start and end inside the window without touching a
+        leg fixed earlier. Legs past the first `commit_days` days (the lookahead) get a slack column priced at the
+        pool's median cost per leg, roughly what covering them later will cost, so the window may leave them for
+        later; committed legs get a slack priced at `artificial_cost`, so a window is never infeasible. Selected
+        pairings that start inside the committed days are fixed, including boundary pairings running into the
+        lookahead whose later legs are then already covered; the rest seed the next window's warm start, together with
+        the pairings of the pool's incumbent (find_incumbent) that fit the window. The window is widened to
+        `commit_days` plus the longest pairing span in the pool, up to twice `window_days`, so that every pairing
+        starting in committed days fits inside it; longer pairings only enter the stitching pass.
+
+        Days split into independent segments wherever no pool pairing crosses from one day to the next; segments are
+        solved in parallel on a thread pool, windows within a segment one after another. A final stitching pass
+        checks the union with is_feasible and, where legs are left uncovered or covered twice, frees a region around
+        them and re-solves it (_stitch). Only one window's model is alive per thread, so solver memory follows the
+        window size. Legs without a day in their id take the earliest start day of the pairings covering them.
+        `time_limit` applies to every window and to the stitching solve.
+
+        The stitched result is then checked against the compiled `instance` (default: the one given to load_compiled,
+        while it is open) with data_coverage_check: legs of the instance outside the loaded pool, legs flown twice,
+        base mismatches and unknown leg ids. The report is kept in `self.coverage` and its failures are printed.
+        """
+        if self.a is None:
+            self.infer_incidence()
+        if not self.c or len(self.c) != self.n:
+            self.load_costs_csv()
+        t0 = time.perf_counter()
+        cover = self.cover_rows()
+
+        day = [leg_day(leg) for leg in self.legs]
+        span = []
+        for j in range(self.n):
+            days = [day[i] for i in self.a.column(j) if day[i] is not None]
+            span.append((min(days), max(days)) if days else None)
+        for i in range(self.m):
+            if day[i] is None:
+                starts = [span[j][0] for j in self.a.row(i) if span[j] is not None]
+                day[i] = min(starts) if starts else 0
+        span = [(min(day[i] for i in self.a.column(j)), max(day[i] for i in self.a.column(j)))
+                if self.a.column(j) else None for j in range(self.n)]
+
+        longest = max((e - b + 1 for b, e in filter(None, span)), default=1)
+        window_days = max(window_days, min(commit_days + longest - 1, 2 * window_days))
+        incumbent = self.find_incumbent() or []
+        per_leg = sorted(self.c[j] / len(self.a.column(j)) for j in range(self.n) if self.a.column(j))
+        lookahead_cost = per_leg[len(per_leg) // 2] if per_leg else 0.0
+        commit_days = max(1, min(commit_days, window_days))
+
+        # independent day segments: no pairing crosses the boundary between them
+        crossing = set()
+        for b, e in filter(None, span):
+            crossing.update(range(b, e))
+        days = sorted(set(day))
+        segments, current = [], [days[0]] if days else []
+        for d in days[1:]:
+            if current[-1] in crossing:
+                current.append(d)
+            else:
+                segments.append(current)
+                current = [d]
+        if current:
+            segments.append(current)
+        print(f"Rolling horizon: {len(days)} days in {len(segments)} independent segments, "
+              f"{window_days}-day windows committing {commit_days} days")
+
+        rows_of_day = {}
+        for i, d in enumerate(day):
+            rows_of_day.setdefault(d, []).append(i)
+        cols_of_start = {}
+        for j, sp in enumerate(span):
+            if sp is not None:
+                cols_of_start.setdefault(sp[0], []).append(j)
+
+        def solve_segment(seg):
+            fixed, covered, carry = [], set(), []
+            first, last = seg[0], seg[-1]
+            s, windows = first, 0
+            while s <= last:
+                e = min(last, s + window_days - 1)
+                commit_end = last if e == last else s + commit_days - 1
+                rows = [i for d in range(s, e + 1) for i in rows_of_day.get(d, []) if i not in covered]
+                cols = [j for d in range(s, e + 1) for j in cols_of_start.get(d, [])
+                        if span[j][1] <= e and not any(i in covered and not cover[i] for i in self.a.column(j))]
+                if rows:
+                    chosen = self._solve_window(rows, cols, day, commit_end, carry + incumbent, backend, time_limit,
+                                                lookahead_cost, artificial_cost)
+                    carry = []
+                    for j in chosen:
+                        if span[j][0] <= commit_end:
+                            fixed.append(j)
+                            covered.update(self.a.column(j))
+                        else:
+                            carry.append(j)
+                    windows += 1
+                s = commit_end + 1
+            return fixed, windows
+
+        with ThreadPoolExecutor(max_workers=n_threads or os.cpu_count()) as pool:
+            results = list(pool.map(solve_segment, segments))
+        selected = sorted(j for fixed, _ in results for j in fixed)
+        n_windows = sum(w for _, w in results)
+
+        if not self.is_feasible(selected):
+            selected = self._stitch(selected, cover, backend, time_limit, incumbent)
+        self.timings = {"build": 0.0, "solve": time.perf_counter() - t0}
+        if selected is None or not self.is_feasible(selected):
+            print(f"Rolling horizon: no exact cover after stitching ({n_windows} windows).")
+            self.diagnose_infeasibility()
+            return []
+        self.solution = selected
+        print(f"Rolling horizon: {n_windows} windows, {len(selected)} pairings, "
+              f"objective {sum(self.c[j] for j in selected)}, {self.timings['solve']:.2f}s")
+
+        instance = instance or self.instance
+        self.coverage = None
+        if instance is not None and not instance.closed:
+            report = self.coverage = self.coverage_report(instance, selected)
+            if report["ok"]:
+                print(f"Exact-cover check: all {report['legs']} legs covered once, bases match")
+            else:
+                print(f"Exact-cover check FAILED: {len(report['missing'])} legs missing, "
+                      f"{len(report['duplicated'])} duplicated, {len(report['base_mismatches'])} base mismatches, "
+                      f"{len(report['unknown'])} unknown leg ids")
+        return selected
+
+    def _solve_window(self, rows, cols, day, commit_end, hints, backend, time_limit, lookahead_cost, artificial_cost):
+        """
+        One rolling-horizon window: pool columns `cols` over `rows`, plus a slack column per row. Pairings of `hints`
+        that fit the window are taken greedily into the warm start while they stay disjoint.
+        """
+        sub = self.subproblem(rows, cols)
+        columns = [list(sub.a.column(k)) for k in range(sub.n)]
+        for k, i in enumerate(rows):
+            columns.append([k])
+            sub.c.append(artificial_cost if day[i] <= commit_end else lookahead_cost)
+        sub.a = SparseIncidence.from_columns(sub.m, columns)
+        sub.n = len(columns)
+
+        # warm start: hinted pairings that fit, slack for every row they leave open
+        position = {j: k for k, j in enumerate(cols)}
+        start, taken = [], set()
+        for j in hints:
+            k = position.get(j)
+            if k is not None and columns[k] and taken.isdisjoint(columns[k]):
+                start.append(k)
+                taken.update(columns[k])
+        start += [len(cols) + k for k in range(len(rows)) if k not in taken]
+        chosen = sub.solve_spp(backend=backend, time_limit=time_limit,
+                               incumbent=start if sub.is_feasible(start) else None, diagnose=False)
+        return [cols[k] for k in chosen if k < len(cols)]
+
+    def _stitch(self, selected, cover, backend, time_limit, incumbent=None, rings=4):
+        """
+        Repairs a union of window solutions that is not an exact cover by freeing a region around the wrongly covered
+        legs and re-solving it over the pool pairings that fit inside. With an `incumbent` partition the region is
+        closed under both solutions (every freed leg's selected and incumbent pairings are freed, with their legs),
+        so the incumbent restricted to it is a warm start and the repair cannot fail. Without one the region grows by
+        rings of conflicting pairings, up to `rings` times, while the sub-SPP stays infeasible.
+        """
+        counts = [0] * self.m
+        for j in selected:
+            for i in self.a.column(j):
+                counts[i] += 1
+        bad = {i for i, k in enumerate(counts) if k == 0 or (k > 1 and not cover[i])}
+        if incumbent:
+            pairings_of = {}
+            for j in list(selected) + list(incumbent):
+                for i in self.a.column(j):
+                    pairings_of.setdefault(i, []).append(j)
+            region, freed, stack = set(bad), set(), list(bad)
+            while stack:
+                for j in pairings_of.get(stack.pop(), []):
+                    if j not in freed:
+                        freed.add(j)
+                        for i in self.a.column(j):
+                            if i not in region:
+                                region.add(i)
+                                stack.append(i)
+            return self._resolve_region(selected, cover, bad, freed, backend, time_limit, 1, warm=incumbent)
+
+        frontier, released = set(bad), set()
+        for ring in range(1, rings + 1):
+            reach = set(frontier)
+            for i in frontier:
+                for j in self.a.row(i):
+                    reach.update(i2 for i2 in self.a.column(j) if not cover[i2])
+            grown = {j for j in selected if j not in released and any(i in reach for i in self.a.column(j))}
+            released |= grown
+            result, frontier = self._resolve_region(selected, cover, bad, released, backend, time_limit, ring), \
+                reach
+            if result is not None or not grown:
+                return result
+        return None
+
+    def _resolve_region(self, selected, cover, bad, released, backend, time_limit, ring, warm=None):
+        """Keeps the selected pairings outside `released` and re-solves the legs they leave open (see _stitch)."""
+        release = set(released)
+        kept = [j for j in selected if j not in release]
+        taken = set()
+        for j in kept:
+            taken.update(self.a.column(j))
+        rows = sorted(bad.union(*(self.a.column(j) for j in release)) - taken)
+        free = set(rows)
+        cols = [j for j in range(self.n)
+                if self.a.column(j) and all(i in free or (cover[i] and i in taken) for i in self.a.column(j))]
+        print(f"Stitching ring {ring}: {len(bad)} legs covered wrongly, re-solving {len(rows)} legs over "
+              f"{len(cols)} pairings")
+        if not rows:
+            return kept
+        sub = self.subproblem(rows, cols)
+        hint = set(warm) if warm else release
+        start = [k for k, j in enumerate(cols) if j in hint]
+        start = start if sub.is_feasible(start) else None
+        if start is None and sub.find_conflicts(limit=1):
+            return None
+        chosen = sub.solve_spp(backend=backend, time_limit=time_limit, incumbent=start, diagnose=False)
+        return sorted(kept + [cols[k] for k in chosen]) if chosen else None
+
     # ============================================================
     #  Diagnose Infeasibility
     # ============================================================
-    def diagnose_infeasibility(self):
+    def find_conflicts(self, limit=10, time_limit=None):
+        """
+        Minimal leg subsets that no selection of pool pairings can partition (spp_diagnostics), smallest first; an
+        empty list means none were found, not that the pool is feasible.
+        """
+        if self.a is None:
+            self.infer_incidence()
+        with trace.span("spp.diagnose", rows=self.m, columns=self.n):
+            diagnostics = self._diagnostics()
+            return diagnostics.conflicts(limit=limit, time_limit=time_limit)
+
+    def _diagnostics(self):
+        bases = [p.get("base") for p in self.pairings] if len(self.pairings) == self.n else None
+        return CoverageDiagnostics(self.a, self.cover_rows(), bases)
+
+    def diagnose_infeasibility(self, conflicts=None):
         """Check which legs cannot be covered
         
         Performs simple structural diagnostics when the SPP is infeasible.
         Identifies legs that are not covered by any pairing and reports coverage multiplicity for sanity checking the incidence structure.
+        Then lists minimal conflicting leg subsets (find_conflicts), with the bases whose pairings touch them.
         """
-        uncoverable_legs = []
+        diagnostics = self._diagnostics()
+        counts = diagnostics.counts
 
-        for i in range(self.m):
-            # Check if leg i appears in any pairing
-            if sum(self.a[i][j] for j in range(self.n)) == 0:
-                uncoverable_legs.append(i)
+        # legs that appear in no pairing
+        uncoverable_legs = [i for i, count in enumerate(counts) if count == 0]
 
         if uncoverable_legs:
             print(f"\nFound {len(uncoverable_legs)} legs that don't appear in any pairing:")
@@ -335,20 +1493,26 @@ class SPPFromCSV:
                 print(f"  ... and {len(uncoverable_legs) - 10} more")
 
         # Check for legs that appear in multiple pairings (good for debugging)
-        multi_coverage = []
-        for i in range(self.m):
-            count = sum(self.a[i][j] for j in range(self.n))
-            if count > 1:
-                multi_coverage.append((i, count))
+        multi_coverage = [(i, count) for i, count in enumerate(counts) if count > 1]
 
         if multi_coverage:
             print(f"\n{len(multi_coverage)} legs appear in multiple pairings (this is OK)")
             print(f"Average coverage: {sum(c for _, c in multi_coverage) / len(multi_coverage):.2f} pairings per leg")
 
+        if conflicts is None:
+            conflicts = diagnostics.conflicts(limit=10, time_limit=30)
+        conflicts = [c for c in conflicts if len(c) > 1]
+        if conflicts:
+            print(f"\n{len(conflicts)} leg subsets cannot be partitioned by the pool:")
+            for conflict in conflicts:
+                bases = ", ".join(f"{b}: {k}" for b, k in diagnostics.bases_covering(conflict.legs).items())
+                print(f"  - {[self.legs[i] for i in conflict.legs]} "
+                      f"({len(conflict.pairings)} pairings{'; ' + bases if bases else ''})")
+
     # ============================================================
     #  Convenience Pipeline
     # ============================================================
-    def run_all(self):
+    def run_all(self, backend="pulp", time_limit=None, presolve=False):
         self.load_legs_csv()
         self.load_pairings_csv()
 
@@ -357,17 +1521,18 @@ class SPPFromCSV:
             self.infer_incidence()
 
         self.load_costs_csv()
-        return self.solve_spp()
+        return self.solve_spp(backend=backend, time_limit=time_limit, presolve=presolve)
 
 
 # ============================================================
 #  COLAB RUNTIME EXECUTION
 # ============================================================
 
-# CHANGE THIS TO YOUR FOLDER
-INSTANCE_PATH = "/content/sample_data/instance1/"
+if __name__ == "__main__":
+    # CHANGE THIS TO YOUR FOLDER
+    INSTANCE_PATH = "/content/sample_data/instance1/"
 
-solver = SPPFromCSV(INSTANCE_PATH)
-solution = solver.run_all()
+    solver = SPPFromCSV(INSTANCE_PATH)
+    solution = solver.run_all()
 
-print("\nDone.")
+    print("\nDone.")
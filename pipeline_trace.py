@@ -0,0 +1,207 @@
+# -*- coding: utf-8 -*-
+"""
+pipeline_trace.py
+
+Scoped timers and counters for the pipeline's hot paths, written as a Chrome trace (chrome://tracing, Perfetto) plus a
+summary table when the process exits.
+
+Tracing is off unless the PIPELINE_TRACE environment variable names an output file (or `enable(path)` is called).
+While it is off, `span()` hands back one shared no-op context manager and `count()`/`gauge()` return at the first
+test, so the calls left in the code cost a global lookup and a function call. Instrumented code therefore uses spans
+around stages (a parse, a solve, a generation round), never around per-pairing work; per-item counts are summed
+locally and reported once with `count(name, n)`.
+
+    import pipeline_trace as trace
+
+    with trace.span("phase4.build", rows=m):
+        ...
+    trace.count("generate.duplicates", dup)
+    trace.gauge("generate.columns_per_s", n / elapsed)
+
+Only the process that enabled tracing records events and writes the file. Child processes (spawned stage runners,
+BatchRunner and generator workers) inherit PIPELINE_TRACE along with PIPELINE_TRACE_PID, the pid of the process that
+read it, and stay disabled; forked children stop recording at the fork. Their work is visible through the counters
+the parent reports after merging their results.
+"""
+
+import atexit
+import functools
+import json
+import os
+import threading
+import time
+
+_enabled = False
+_path = None
+_pid = None          # process that enabled tracing: the only one that records and writes
+_t0 = time.perf_counter_ns()
+_lock = threading.Lock()
+_events = []
+_spans = {}          # name -> [calls, total ns, max ns]
+_counters = {}       # name -> total
+_gauges = {}         # name -> last value
+
+
+class _NullSpan:
+    __slots__ = ()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        return False
+
+    def set(self, **args):
+        pass
+
+
+_NULL = _NullSpan()
+
+
+class _Span:
+    __slots__ = ("name", "args", "start")
+
+    def __init__(self, name, args):
+        self.name = name
+        self.args = args
+        self.start = 0
+
+    def set(self, **args):
+        """Attaches more arguments (e.g. result sizes) to the span before it closes."""
+        self.args.update(args)
+
+    def __enter__(self):
+        self.start = time.perf_counter_ns()
+        return self
+
+    def __exit__(self, *exc):
+        end = time.perf_counter_ns()
+        dur = end - self.start
+        event = {"name": self.name, "ph": "X", "ts": (self.start - _t0) / 1000.0, "dur": dur / 1000.0,
+                 "pid": os.getpid(), "tid": threading.get_ident()}
+        if self.args:
+            event["args"] = self.args
+        with _lock:
+            _events.append(event)
+            _add_stat(self.name, dur)
+        return False
+
+
+def _add_stat(name, dur):
+    stat = _spans.get(name)
+    if stat is None:
+        _spans[name] = [1, dur, dur]
+    else:
+        stat[0] += 1
+        stat[1] += dur
+        if dur > stat[2]:
+            stat[2] = dur
+
+
+def enabled():
+    return _enabled
+
+
+def enable(path="pipeline_trace.json"):
+    """Starts recording; the trace is written to `path` (and the summary printed) at exit or on `flush()`."""
+    global _enabled, _path, _pid
+    if not _enabled:
+        atexit.register(flush)
+    _enabled, _path, _pid = True, path, os.getpid()
+
+
+def _after_fork_in_child():
+    global _enabled
+    _enabled = False
+
+
+def span(name, **args):
+    """Context manager timing the enclosed block as one trace slice named `name`."""
+    if not _enabled:
+        return _NULL
+    return _Span(name, args)
+
+
+def traced(name=None):
+    """Decorator form of `span`."""
+    def wrap(fn):
+        label = name or fn.__qualname__
+
+        @functools.wraps(fn)        # keeps __qualname__/__module__, so decorated functions still pickle for workers
+        def inner(*a, **k):
+            if not _enabled:
+                return fn(*a, **k)
+            with _Span(label, {}):
+                return fn(*a, **k)
+        return inner
+    return wrap
+
+
+def record(name, start, end, **args):
+    """
+    Adds a slice for code that already times itself: `start` and `end` are time.perf_counter() readings in seconds.
+    """
+    if not _enabled:
+        return
+    begin, dur = int(start * 1e9), int((end - start) * 1e9)
+    event = {"name": name, "ph": "X", "ts": (begin - _t0) / 1000.0, "dur": dur / 1000.0,
+             "pid": os.getpid(), "tid": threading.get_ident()}
+    if args:
+        event["args"] = args
+    with _lock:
+        _events.append(event)
+        _add_stat(name, dur)
+
+
+def count(name, value=1):
+    """Adds `value` to counter `name`; the running total is also emitted as a trace counter track."""
+    if not _enabled:
+        return
+    with _lock:
+        total = _counters[name] = _counters.get(name, 0) + value
+        _events.append({"name": name, "ph": "C", "ts": (time.perf_counter_ns() - _t0) / 1000.0,
+                        "pid": os.getpid(), "args": {"value": total}})
+
+
+def gauge(name, value):
+    """Records the current value of a rate or size (last value wins in the summary)."""
+    if not _enabled:
+        return
+    with _lock:
+        _gauges[name] = value
+        _events.append({"name": name, "ph": "C", "ts": (time.perf_counter_ns() - _t0) / 1000.0,
+                        "pid": os.getpid(), "args": {"value": value}})
+
+
+def summary():
+    """The summary table as a string: spans by total time, then counters and gauges."""
+    lines = [f"{'span':<40} {'calls':>7} {'total s':>10} {'mean ms':>10} {'max ms':>10}"]
+    for name, (calls, total, peak) in sorted(_spans.items(), key=lambda kv: -kv[1][1]):
+        lines.append(f"{name:<40} {calls:>7} {total / 1e9:>10.3f} {total / calls / 1e6:>10.2f} {peak / 1e6:>10.2f}")
+    if _counters or _gauges:
+        lines.append(f"{'counter':<40} {'value':>18}")
+        for name, value in sorted(_counters.items()):
+            lines.append(f"{name:<40} {value:>18,}")
+        for name, value in sorted(_gauges.items()):
+            lines.append(f"{name:<40} {value:>18,.2f}")
+    return "\n".join(lines)
+
+
+def flush():
+    """Writes the Chrome trace JSON and prints the summary table."""
+    if not _enabled or _path is None or os.getpid() != _pid:
+        return
+    with _lock:
+        events = list(_events)
+    with open(_path, "w") as f:
+        json.dump({"traceEvents": events, "displayTimeUnit": "ms"}, f)
+    print(f"\nTrace written to {_path} ({len(events)} events)")
+    print(summary())
+
+
+os.register_at_fork(after_in_child=_after_fork_in_child)
+
+if os.environ.get("PIPELINE_TRACE"):
+    # the first process to import this claims the trace; children inherit the claim and stay disabled
+    if os.environ.setdefault("PIPELINE_TRACE_PID", str(os.getpid())) == str(os.getpid()):
+        enable(os.environ["PIPELINE_TRACE"])
@@ -0,0 +1,303 @@
+# -*- coding: utf-8 -*-
+"""
+pool_store.py
+
+Chunked binary format for candidate pairing pools, written in a stream by the Phase 3 generators and read in a stream
+by Phase 4 (SPPFromCSV.load_pool) and the Phase 2 scorer, instead of one pretty-printed JSON list per pool.
+
+File layout (little-endian):
+    header      magic b"CRWP", u32 version, u32 codec (0 raw, 1 zlib, 2 zstd)
+    chunks      b"CHNK", u32 pairings, u32 raw bytes, u32 stored bytes, then the (compressed) payload
+    trailer     b"END\\0", u32 0, u64 total pairings
+
+Chunk payload, all integers unsigned LEB128 varints:
+    new leg names             count, then (byte length, utf-8) per name; they extend the pool's LegDictionary, so leg
+                              codes (see leg_dictionary.py) in later chunks may refer to them
+    new base names            same layout, extending the base table
+    lengths                   legs per pairing
+    codes                     per pairing, the first leg code, then zig-zag deltas to the previous code
+    bases                     base id per pairing
+    costs                     raw float64 per pairing (8-byte little-endian)
+
+Only one chunk is ever held in memory on either side. zstd is used when the `zstandard` package is installed, zlib
+otherwise; readers pick the codec from the header.
+"""
+
+import struct
+import sys
+import zlib
+from array import array
+
+from leg_dictionary import LegDictionary
+
+try:
+    import zstandard
+except ImportError:  # optional, zlib is the fallback codec
+    zstandard = None
+
+MAGIC = b"CRWP"
+VERSION = 1
+CODEC_RAW, CODEC_ZLIB, CODEC_ZSTD = 0, 1, 2
+DEFAULT_CHUNK = 65536
+
+_HEADER = struct.Struct("<4sII")
+_CHUNK = struct.Struct("<4sIII")
+_TRAILER = struct.Struct("<4sIQ")
+
+
+def _put_varint(out, v):
+    while v > 0x7F:
+        out.append((v & 0x7F) | 0x80)
+        v >>= 7
+    out.append(v)
+
+
+def _varints(buf, pos, count):
+    """Decodes `count` varints from buf[pos:]; returns (values, new position)."""
+    values = []
+    append = values.append
+    for _ in range(count):
+        b = buf[pos]
+        pos += 1
+        if b < 0x80:
+            append(b)
+            continue
+        v = b & 0x7F
+        shift = 7
+        while True:
+            b = buf[pos]
+            pos += 1
+            v |= (b & 0x7F) << shift
+            if b < 0x80:
+                break
+            shift += 7
+        append(v)
+    return values, pos
+
+
+def _put_names(out, names):
+    _put_varint(out, len(names))
+    for name in names:
+        raw = name.encode("utf-8")
+        _put_varint(out, len(raw))
+        out += raw
+
+
+def _names(buf, pos):
+    (count,), pos = _varints(buf, pos, 1)
+    names = []
+    for _ in range(count):
+        (length,), pos = _varints(buf, pos, 1)
+        names.append(bytes(buf[pos:pos + length]).decode("utf-8"))
+        pos += length
+    return names, pos
+
+
+def _compressor(codec):
+    if codec == CODEC_ZSTD:
+        return zstandard.ZstdCompressor(level=3).compress
+    if codec == CODEC_ZLIB:
+        return lambda raw: zlib.compress(raw, 6)
+    return bytes
+
+
+def _decompressor(codec):
+    if codec == CODEC_ZSTD:
+        if zstandard is None:
+            raise RuntimeError("pool was written with zstd — install the zstandard package to read it")
+        d = zstandard.ZstdDecompressor()
+        return lambda raw, size: d.decompress(raw, max_output_size=size)
+    if codec == CODEC_ZLIB:
+        return lambda raw, size: zlib.decompress(raw)
+    return lambda raw, size: raw
+
+
+class PoolWriter:
+    """
+    Appends pairings to a pool file chunk by chunk. `codec` is "auto" (zstd if available, else zlib), "zstd",
+    "zlib" or "raw".
+
+        with PoolWriter("mixed.pool") as w:
+            w.append(["LEG_01_3", "TDH_LEG_01_7"], "BASE1", 700)
+    """
+
+    def __init__(self, path, chunk_size=DEFAULT_CHUNK, codec="auto"):
+        if codec == "auto":
+            codec = "zstd" if zstandard is not None else "zlib"
+        self.codec = {"raw": CODEC_RAW, "zlib": CODEC_ZLIB, "zstd": CODEC_ZSTD}[codec]
+        if self.codec == CODEC_ZSTD and zstandard is None:
+            raise RuntimeError("zstandard is not installed")
+        self._compress = _compressor(self.codec)
+        self.path = path
+        self.chunk_size = chunk_size
+        self.legs = LegDictionary()
+        self.bases = {}
+        self._legs_written = 0
+        self._bases_written = 0
+        self._lengths = []
+        self._codes = []
+        self._base_ids = []
+        self._costs = array("d")
+        self.count = 0
+        self._file = open(path, "wb")
+        self._file.write(_HEADER.pack(MAGIC, VERSION, self.codec))
+
+    def append(self, duties, base, cost):
+        """Adds one pairing (leg tokens, base name, cost)."""
+        self.append_codes(self.legs.encode(duties), base, cost)
+
+    def append_codes(self, codes, base, cost):
+        """Adds one pairing whose leg codes come from this writer's `legs` dictionary."""
+        b = self.bases.get(base)
+        if b is None:
+            b = self.bases[base] = len(self.bases)
+        self._lengths.append(len(codes))
+        self._codes.extend(codes)
+        self._base_ids.append(b)
+        self._costs.append(cost)
+        if len(self._lengths) >= self.chunk_size:
+            self.flush()
+
+    def flush(self):
+        n = len(self._lengths)
+        if not n:
+            return
+        out = bytearray()
+        _put_names(out, self.legs.names[self._legs_written:])
+        base_names = list(self.bases)
+        _put_names(out, base_names[self._bases_written:])
+        self._legs_written, self._bases_written = len(self.legs.names), len(base_names)
+
+        for length in self._lengths:
+            _put_varint(out, length)
+        pos = 0
+        for length in self._lengths:
+            prev = 0
+            for code in self._codes[pos:pos + length]:
+                delta = code - prev
+                _put_varint(out, (delta << 1) if delta >= 0 else ((-delta << 1) - 1))
+                prev = code
+            pos += length
+        for b in self._base_ids:
+            _put_varint(out, b)
+        costs = self._costs
+        if sys.byteorder != "little":
+            costs = array("d", costs)
+            costs.byteswap()
+        out += costs.tobytes()
+
+        stored = self._compress(bytes(out))
+        self._file.write(_CHUNK.pack(b"CHNK", n, len(out), len(stored)))
+        self._file.write(stored)
+        self.count += n
+        self._lengths, self._codes, self._base_ids, self._costs = [], [], [], array("d")
+
+    def close(self):
+        if self._file is None:
+            return
+        self.flush()
+        self._file.write(_TRAILER.pack(b"END\0", 0, self.count))
+        self._file.close()
+        self._file = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+class PoolChunk:
+    """One decoded chunk: CSR leg codes (`offsets`, `codes`), base ids, costs; codes refer to the reader's `legs`."""
+
+    def __init__(self, offsets, codes, base_ids, costs):
+        self.offsets = offsets
+        self.codes = codes
+        self.base_ids = base_ids
+        self.costs = costs
+
+    def __len__(self):
+        return len(self.base_ids)
+
+    def pairing(self, k):
+        return self.codes[self.offsets[k]:self.offsets[k + 1]]
+
+
+class PoolReader:
+    """
+    Streams a pool file. `chunks()` yields PoolChunk objects; iterating the reader yields Phase 3 style dicts
+    ({"base", "duties", "cost"}). `legs` and `bases` grow as chunks are read.
+    """
+
+    def __init__(self, path):
+        self.path = path
+        self.legs = LegDictionary()
+        self.bases = []
+        with open(path, "rb") as f:
+            magic, version, codec = _HEADER.unpack(f.read(_HEADER.size))
+        if magic != MAGIC:
+            raise ValueError(f"{path} is not a pairing pool file")
+        if version != VERSION:
+            raise ValueError(f"{path} has pool version {version}, expected {VERSION}")
+        self.codec = codec
+        self._decompress = _decompressor(codec)
+
+    def chunks(self):
+        with open(self.path, "rb") as f:
+            f.seek(_HEADER.size)
+            while True:
+                head = f.read(_CHUNK.size)
+                if len(head) < _CHUNK.size or head[:4] == b"END\0":
+                    return
+                tag, n, raw_size, stored_size = _CHUNK.unpack(head)
+                if tag != b"CHNK":
+                    raise ValueError(f"{self.path}: corrupt chunk header")
+                buf = memoryview(self._decompress(f.read(stored_size), raw_size))
+                yield self._decode(buf, n)
+
+    def _decode(self, buf, n):
+        names, pos = _names(buf, 0)
+        for name in names:
+            self.legs.code(name)
+        names, pos = _names(buf, pos)
+        self.bases.extend(names)
+
+        lengths, pos = _varints(buf, pos, n)
+        offsets = array("I", [0])
+        total = 0
+        for length in lengths:
+            total += length
+            offsets.append(total)
+        raw, pos = _varints(buf, pos, total)
+        codes = array("I", bytes(4 * total))
+        k = 0
+        for length in lengths:
+            prev = 0
+            for _ in range(length):
+                z = raw[k]
+                prev += (z >> 1) if not z & 1 else -((z + 1) >> 1)
+                codes[k] = prev
+                k += 1
+        base_ids, pos = _varints(buf, pos, n)
+        costs = array("d")
+        costs.frombytes(bytes(buf[pos:pos + 8 * n]))
+        if sys.byteorder != "little":
+            costs.byteswap()
+        return PoolChunk(offsets, codes, base_ids, costs)
+
+    def __iter__(self):
+        for chunk in self.chunks():
+            for k in range(len(chunk)):
+                yield {
+                    "base": self.bases[chunk.base_ids[k]],
+                    "duties": self.legs.decode(chunk.pairing(k)),
+                    "cost": chunk.costs[k],
+                }
+
+
+def write_pool(path, pool, **kwargs):
+    """Writes an in-memory pool (list of Phase 3 dicts) to `path`; returns the number of pairings."""
+    with PoolWriter(path, **kwargs) as w:
+        for p in pool:
+            w.append(p["duties"], p["base"], p["cost"])
+    return w.count
@@ -0,0 +1,231 @@
+# -*- coding: utf-8 -*-
+"""
+spp_diagnostics.py
+
+Structural infeasibility diagnostics for the set-partitioning problem, cheap enough to run before handing a pool to
+the MIP.
+
+Works on a phase-4 SparseIncidence and the covering-row flags, like spp_heuristic. Sets of pairings are Python ints
+used as bitsets, so unions, intersections and counts run word by word inside the interpreter (|, &, int.bit_count)
+instead of element by element:
+
+    coverage        per-leg cover counts straight from the CSR row pointers; legs no pairing covers
+    base bitsets    the pairings of each base as one bitset, for the per-base coverage of a set of legs
+    conflicts       small leg subsets that no selection of pairings can partition, e.g. a leg whose every pairing
+                    overlaps (on an exactly covered leg) every pairing of some other leg
+
+Conflicts are found by propagation: a pairing that overlaps every remaining pairing of some leg k (and does not cover
+k itself) can never be selected, and is removed; a leg left without pairings is infeasible. Only legs with few
+remaining pairings are examined, so the pass stays close to linear in the pool and misses conflicts that need deeper
+reasoning (those are left to the solver). Each conflict is then shrunk to a minimal leg subset: the problem restricted
+to those legs is re-propagated on bitsets over the handful of pairings that touch them, and legs are dropped while
+the restriction stays infeasible. A restriction is a relaxation, so every reported subset is a true certificate.
+"""
+
+import time
+
+
+def to_bitset(indices, size):
+    """Bitset (int) with the bits of `indices` set; `size` is an upper bound on the indices."""
+    buf = bytearray((size >> 3) + 1)
+    for j in indices:
+        buf[j >> 3] |= 1 << (j & 7)
+    return int.from_bytes(buf, "little")
+
+
+def members(bits):
+    """Indices of the set bits, ascending."""
+    out = []
+    while bits:
+        low = bits & -bits
+        out.append(low.bit_length() - 1)
+        bits ^= low
+    return out
+
+
+class Conflict:
+    """A set of legs (row indices) that no selection of pairings covers exactly, with the pairings touching them."""
+
+    def __init__(self, legs, pairings):
+        self.legs = legs
+        self.pairings = pairings
+
+    def __len__(self):
+        return len(self.legs)
+
+    def __repr__(self):
+        return f"Conflict(legs={self.legs}, pairings={len(self.pairings)})"
+
+
+class CoverageDiagnostics:
+    """
+    Diagnostics over a SparseIncidence `a`. `cover_rows` flags the rows that need >= 1 (deadhead legs); `bases`
+    optionally gives each pairing's base name for `bases_covering`.
+    """
+
+    def __init__(self, a, cover_rows=None, bases=None):
+        self.a = a
+        self.m, self.n = a.m, a.n
+        self.cover = cover_rows or bytearray(self.m)
+        self.counts = a.row_counts()
+        self.uncovered = [i for i, k in enumerate(self.counts) if k == 0]
+        self.base_bits = {}
+        if bases is not None:
+            by_base = {}
+            for j, base in enumerate(bases):
+                by_base.setdefault(base, []).append(j)
+            self.base_bits = {base: to_bitset(cols, self.n) for base, cols in by_base.items()}
+
+    def bases_covering(self, legs):
+        """{base: number of its pairings covering at least one of `legs`}, bases without any left out."""
+        cols = set()
+        for i in legs:
+            cols.update(self.a.row(i))
+        bits = to_bitset(cols, self.n)
+        counts = {base: (bits & b).bit_count() for base, b in self.base_bits.items()}
+        return {base: k for base, k in counts.items() if k}
+
+    # ------------------------------------------------------------
+    # Propagation over the whole pool
+    # ------------------------------------------------------------
+    def _exact(self, j):
+        cover = self.cover
+        return [i for i in self.a.column(j) if not cover[i]]
+
+    def conflicts(self, limit=10, max_count=4, time_limit=None):
+        """
+        Up to `limit` minimal conflicting leg subsets, smallest first. Legs are examined once at most `max_count`
+        of their pairings remain; `time_limit` (seconds) bounds the propagation.
+        """
+        a = self.a
+        deadline = time.perf_counter() + time_limit if time_limit else None
+        alive = bytearray(b"\x01") * self.n
+        remaining = list(self.counts)
+        killer = {}                      # dead pairing -> (leg it would have blocked, witness rows)
+        found = []
+        queue = [i for i in range(self.m) if remaining[i] <= max_count]
+        queued = bytearray(self.m)
+        for i in queue:
+            queued[i] = 1
+
+        while queue and len(found) < limit:
+            if deadline and time.perf_counter() > deadline:
+                break
+            k = queue.pop()
+            queued[k] = 0
+            cols = [j for j in a.row(k) if alive[j]]
+            if not cols:
+                if k not in found:
+                    found.append(k)
+                continue
+
+            # pairings overlapping every remaining pairing of leg k on an exactly covered leg
+            blockers = None
+            for j in cols:
+                overlap = set()
+                for i in self._exact(j):
+                    overlap.update(a.row(i))
+                blockers = overlap if blockers is None else blockers & overlap
+                if not blockers:
+                    break
+            if not blockers:
+                continue
+            blockers.difference_update(a.row(k))
+
+            for b in blockers:
+                if not alive[b]:
+                    continue
+                rows = set(self._exact(b))
+                killer[b] = (k, [next(i for i in self._exact(j) if i in rows) for j in cols])
+                alive[b] = 0
+                for i in a.column(b):
+                    remaining[i] -= 1
+                    if remaining[i] <= max_count and not queued[i]:
+                        queued[i] = 1
+                        queue.append(i)
+
+        out = [self._minimal(i, killer) for i in found]
+        out.sort(key=len)
+        return out
+
+    # ------------------------------------------------------------
+    # Explanation and minimization on the restricted problem
+    # ------------------------------------------------------------
+    def _explain(self, i, killer):
+        """Leg `i` plus, recursively, the legs and witness rows that removed its pairings."""
+        legs = {i}
+        stack = [j for j in self.a.row(i) if j in killer]
+        seen = set(stack)
+        while stack:
+            k, witnesses = killer[stack.pop()]
+            for r in (k, *witnesses):
+                if r not in legs:
+                    legs.add(r)
+                    for j in self.a.row(r):
+                        if j in killer and j not in seen:
+                            seen.add(j)
+                            stack.append(j)
+        return legs
+
+    def _restrict(self, legs):
+        """Pairings touching `legs` projected onto them: (local row bitsets, local overlap bitsets, pairings)."""
+        local = {i: r for r, i in enumerate(sorted(legs))}
+        exact = 0
+        for i, r in local.items():
+            if not self.cover[i]:
+                exact |= 1 << r
+        masks = {}
+        for i in legs:
+            for j in self.a.row(i):
+                if j not in masks:
+                    mask = 0
+                    for r in (local.get(i2) for i2 in self.a.column(j)):
+                        if r is not None:
+                            mask |= 1 << r
+                    masks[j] = mask
+        projections = {}                 # distinct projections behave identically: keep one per mask
+        for j, mask in masks.items():
+            projections.setdefault(mask, j)
+        cols = list(projections)
+        row_bits = [0] * len(local)
+        for c, mask in enumerate(cols):
+            for r in members(mask):
+                row_bits[r] |= 1 << c
+        overlap = []
+        for mask in cols:
+            bits = 0
+            for r in members(mask & exact):
+                bits |= row_bits[r]
+            overlap.append(bits)
+        return row_bits, overlap, sorted(masks)
+
+    @staticmethod
+    def _infeasible(row_bits, overlap):
+        alive = (1 << len(overlap)) - 1
+        changed = True
+        while changed:
+            changed = False
+            for bits in row_bits:
+                live = bits & alive
+                if not live:
+                    return True
+                blockers = alive & ~bits
+                for c in members(live):
+                    blockers &= overlap[c]
+                    if not blockers:
+                        break
+                if blockers:
+                    alive &= ~blockers
+                    changed = True
+        return False
+
+    def _minimal(self, i, killer):
+        legs = self._explain(i, killer)
+        row_bits, overlap, pairings = self._restrict(legs)
+        if self._infeasible(row_bits, overlap):
+            for k in sorted(legs, key=lambda r: r == i):      # the empty leg itself is tried last
+                trial = legs - {k}
+                if trial and self._infeasible(*self._restrict(trial)[:2]):
+                    legs = trial
+            pairings = self._restrict(legs)[2]
+        return Conflict(sorted(legs), pairings)
@@ -0,0 +1,250 @@
+# -*- coding: utf-8 -*-
+"""
+spp_heuristic.py
+
+Anytime primal heuristic for the set-partitioning problem, used by SPPFromCSV.solve_spp(backend="heuristic") when
+proving optimality with CBC is not worth the wait.
+
+Three parts share one time budget:
+
+    Lagrangian relaxation   all leg rows are dualized; subgradient steps on the multipliers give the lower bound
+                            L(u) = sum(u) + sum(min(0, c_j - u(col_j))) reported with the result
+    greedy                  every few iterations, pairings are taken in order of Lagrangian reduced cost while they
+                            do not cover an already covered leg twice; complete partitions become incumbents
+    local search            ejection moves on the incumbent: a small group of selected pairings that a pool column
+                            straddles is removed and the freed legs are re-covered exactly by a cheaper set of pool
+                            columns found with a bounded depth-first search
+
+Rows flagged as covering rows (deadhead legs) need >= 1 instead of exactly 1, like in the exact backends.
+"""
+
+import random
+import time
+
+
+class SPPHeuristic:
+    """
+    Works on the CSC/CSR arrays of a phase-4 SparseIncidence (`a`), the cost vector and the covering-row flags.
+    """
+
+    def __init__(self, a, costs, cover_rows=None, seed=0):
+        self.m, self.n = a.m, a.n
+        self.cols = [tuple(a.column(j)) for j in range(self.n)]
+        self.rows = [tuple(a.row(i)) for i in range(self.m)]
+        self.c = [float(v) for v in costs]
+        self.cover = cover_rows or bytearray(self.m)
+        self.exact = [tuple(i for i in col if not self.cover[i]) for col in self.cols]
+        self.rng = random.Random(seed)
+
+    # ------------------------------------------------------------
+    # Lagrangian relaxation
+    # ------------------------------------------------------------
+    def _initial_multipliers(self):
+        u = [0.0] * self.m
+        for i, row in enumerate(self.rows):
+            if row:
+                u[i] = min(self.c[j] / len(self.cols[j]) for j in row)
+        return u
+
+    def _reduced_costs(self, u):
+        return [c_j - sum(u[i] for i in col) for c_j, col in zip(self.c, self.cols)]
+
+    def _lagrangian(self, u):
+        rc = self._reduced_costs(u)
+        bound = sum(u) + sum(r for r in rc if r < 0)
+        g = [1] * self.m
+        for j, r in enumerate(rc):
+            if r < 0:
+                for i in self.cols[j]:
+                    g[i] -= 1
+        return bound, rc, g
+
+    # ------------------------------------------------------------
+    # Primal construction
+    # ------------------------------------------------------------
+    def cost(self, sol):
+        return sum(self.c[j] for j in sol)
+
+    def feasible(self, sol):
+        counts = [0] * self.m
+        for j in sol:
+            for i in self.cols[j]:
+                counts[i] += 1
+        return all(k == 1 or (k > 1 and self.cover[i]) for i, k in enumerate(counts))
+
+    def greedy(self, scores):
+        """Partition built by taking columns in ascending `scores`; None if some leg ends up uncovered."""
+        covered = bytearray(self.m)
+        left = self.m
+        sol = []
+        for j in sorted(range(self.n), key=scores.__getitem__):
+            col = self.cols[j]
+            if not col or any(covered[i] for i in self.exact[j]):
+                continue
+            new = sum(1 for i in col if not covered[i])
+            if not new:
+                continue
+            for i in col:
+                covered[i] = 1
+            left -= new
+            sol.append(j)
+            if not left:
+                return sol
+        return None
+
+    # ------------------------------------------------------------
+    # Local search
+    # ------------------------------------------------------------
+    def _exact_cover(self, need, allowed, budget, depth=4):
+        """
+        Cheapest set of columns (exact rows inside `allowed`) covering every row of `need`, with no exact row covered
+        twice. Bounded DFS branching on the requirement with fewest candidates; returns (cost, columns) or None.
+        """
+        best = [None, None]
+        nodes = [budget]
+
+        def dfs(need, used, chosen, cost):
+            if best[0] is not None and cost >= best[0] - 1e-9:
+                return
+            if not need:
+                best[0], best[1] = cost, list(chosen)
+                return
+            if len(chosen) >= depth or nodes[0] <= 0:
+                return
+            nodes[0] -= 1
+            r = None
+            options = None
+            for i in need:
+                opts = [k for k in self.rows[i]
+                        if all(x in allowed and x not in used for x in self.exact[k])]
+                if options is None or len(opts) < len(options):
+                    r, options = i, opts
+                    if not opts:
+                        return
+            for k in sorted(options, key=self.c.__getitem__):
+                chosen.append(k)
+                dfs(need - set(self.cols[k]), used | set(self.exact[k]), chosen, cost + self.c[k])
+                chosen.pop()
+
+        dfs(set(need), frozenset(), [], 0.0)
+        return None if best[0] is None else (best[0], best[1])
+
+    def local_search(self, sol, deadline, max_group=3, budget=200):
+        """Ejection moves on `sol` until no move improves it or the deadline passes."""
+        sol = set(sol)
+        owner = {}                              # exact row -> selected column
+        count = [0] * self.m
+        for j in sol:
+            for i in self.cols[j]:
+                count[i] += 1
+                if not self.cover[i]:
+                    owner[i] = j
+
+        improved = True
+        while improved and time.perf_counter() < deadline:
+            improved = False
+            order = list(sol)
+            self.rng.shuffle(order)
+            for j1 in order:
+                if time.perf_counter() >= deadline:
+                    break
+                if j1 not in sol:
+                    continue
+                # groups of selected columns that some pool column straddles together with j1
+                groups = {frozenset([j1])}
+                for i in self.exact[j1]:
+                    for k in self.rows[i]:
+                        group = {owner[x] for x in self.exact[k] if x in owner}
+                        if j1 in group and len(group) <= max_group:
+                            groups.add(frozenset(group))
+                for group in groups:
+                    allowed = {i for j in group for i in self.exact[j]}
+                    need = set(allowed)
+                    for j in group:
+                        for i in self.cols[j]:
+                            if self.cover[i]:
+                                drop = sum(1 for g in group if i in self.cols[g])
+                                if count[i] - drop <= 0:
+                                    need.add(i)
+                    old = sum(self.c[j] for j in group)
+                    found = self._exact_cover(need, allowed, budget)
+                    if found is None or found[0] >= old - 1e-9 or set(found[1]) == set(group):
+                        continue
+                    for j in group:
+                        sol.discard(j)
+                        for i in self.cols[j]:
+                            count[i] -= 1
+                    for k in found[1]:
+                        sol.add(k)
+                        for i in self.cols[k]:
+                            count[i] += 1
+                            if not self.cover[i]:
+                                owner[i] = k
+                    improved = True
+                    break
+        return sorted(sol)
+
+    # ------------------------------------------------------------
+    # Driver
+    # ------------------------------------------------------------
+    def solve(self, time_limit=10.0, start=None, greedy_every=10, max_iters=None):
+        """
+        Runs the heuristic for `time_limit` seconds (or `max_iters` subgradient iterations). Returns
+        (best partition or None, its cost, best lower bound). The multipliers of the best bound are kept in
+        `self.multipliers` (row dual estimates).
+        """
+        t0 = time.perf_counter()
+        deadline = t0 + time_limit
+        best, best_cost = None, float("inf")
+        if start and self.feasible(start):
+            best, best_cost = sorted(start), self.cost(start)
+
+        sol = self.greedy(self.c)
+        if sol is not None and self.cost(sol) < best_cost:
+            best, best_cost = sol, self.cost(sol)
+        if best is not None:
+            best = self.local_search(best, t0 + 0.2 * time_limit)
+            best_cost = self.cost(best)
+
+        u = self._initial_multipliers()
+        self.multipliers = list(u)
+        lower = float("-inf")
+        step, stalled, it = 2.0, 0, 0
+        while time.perf_counter() < deadline and (max_iters is None or it < max_iters):
+            it += 1
+            bound, rc, g = self._lagrangian(u)
+            if bound > lower + 1e-9:
+                lower, stalled = bound, 0
+                self.multipliers = list(u)
+            else:
+                stalled += 1
+                if stalled >= 30:
+                    step, stalled = step / 2, 0
+            if best_cost - lower <= 1e-6 * max(1.0, abs(best_cost)):
+                break
+
+            if it % greedy_every == 0:
+                sol = self.greedy(rc)
+                if sol is not None:
+                    sol = self.local_search(sol, min(deadline, time.perf_counter() + 0.05 * time_limit))
+                    if self.cost(sol) < best_cost:
+                        best, best_cost = sol, self.cost(sol)
+                        print(f"  heuristic iter {it}: incumbent {best_cost:.2f}, lower bound {lower:.2f}")
+
+            for i in range(self.m):
+                if self.cover[i] and u[i] <= 0 and g[i] < 0:
+                    g[i] = 0
+            norm = sum(v * v for v in g)
+            if norm == 0 or step < 1e-4:
+                break
+            target = best_cost if best is not None else abs(bound) * 1.05 + 1.0
+            t = step * (target - bound) / norm
+            for i in range(self.m):
+                u[i] += t * g[i]
+                if self.cover[i] and u[i] < 0:
+                    u[i] = 0.0
+
+        if best is not None and time.perf_counter() < deadline:
+            best = self.local_search(best, deadline)
+            best_cost = self.cost(best)
+        return best, best_cost, lower
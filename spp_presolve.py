@@ -0,0 +1,249 @@
+# -*- coding: utf-8 -*-
+"""
+spp_presolve.py
+
+Set-partitioning specific presolve run between loading a pool and handing it to the MIP.
+
+The problem is given as plain columns (sorted leg-row indices per pairing), costs and the flags of covering rows
+(rows that need >= 1 instead of exactly 1, i.e. deadhead legs). Reductions are applied until nothing changes:
+
+    duplicate columns   pairings over the same (remaining) legs: only the cheapest is kept
+    forced columns      a leg covered by a single pairing fixes that pairing; every other pairing touching one of its
+                        exactly-covered legs conflicts with it and is removed, and its legs leave the problem
+    row dominance       if every pairing covering leg r1 also covers leg r2, pairings covering r2 but not r1 can never
+                        be selected (r2 would be covered twice); identical and implied rows are dropped
+    empty columns       pairings left without legs are fixed when they have negative cost, dropped otherwise
+
+What remains is split into independent connected components (pairings of different bases or days rarely share legs),
+and the result maps a solution of the reduced problem back to the original pairing indices.
+"""
+
+import time
+
+
+class PresolveResult:
+    """
+    Outcome of `presolve`: the kept rows and columns (original indices), the fixed columns, the independent
+    components of the reduced problem, and `infeasible` (None, or the reason no partition exists).
+    """
+
+    def __init__(self, m, n, rows, columns, fixed, fixed_cost, representative, components, infeasible, stats):
+        self.m = m
+        self.n = n
+        self.rows = rows                      # kept original row indices, ascending
+        self.columns = columns                # kept original column indices, ascending
+        self.fixed = fixed                    # original column indices selected by presolve
+        self.fixed_cost = fixed_cost
+        self.representative = representative  # removed duplicate column -> kept column over the same legs
+        self.components = components          # [(original rows, original columns)] of the reduced problem
+        self.infeasible = infeasible
+        self.stats = stats
+
+    def _resolve(self, j):
+        while j in self.representative:
+            j = self.representative[j]
+        return j
+
+    def map_start(self, start):
+        """
+        Reduced-problem column positions of an original feasible solution (e.g. an incumbent), or None when it does
+        not survive presolve. Removed duplicates are replaced by their cheaper representative.
+        """
+        position = {j: k for k, j in enumerate(self.columns)}
+        fixed = set(self.fixed)
+        out = []
+        for j in start:
+            j = self._resolve(j)
+            if j in fixed:
+                continue
+            k = position.get(j)
+            if k is None:
+                return None
+            out.append(k)
+        return out
+
+    def restore(self, selected):
+        """Original pairing indices of a reduced-problem solution (positions into `columns`) plus the fixed ones."""
+        return sorted(self.fixed + [self.columns[k] for k in selected])
+
+    def report(self):
+        st = self.stats
+        lines = [
+            f"Presolve ({st['passes']} passes, {st['seconds']:.2f}s): "
+            f"rows {self.m} -> {len(self.rows)}, columns {self.n} -> {len(self.columns)}, "
+            f"nonzeros {st['nnz_before']} -> {st['nnz_after']}",
+            f"  fixed {len(self.fixed)} columns (cost {self.fixed_cost}), removed {st['duplicates']} duplicate, "
+            f"{st['conflicts']} conflicting, {st['dominated']} dominated, {st['empty']} empty columns; "
+            f"dropped {st['rows_dropped']} rows",
+            f"  {len(self.components)} independent components"
+            + (f" (largest {max(len(c) for _, c in self.components)} columns)" if self.components else ""),
+        ]
+        if self.infeasible:
+            lines.append(f"  INFEASIBLE: {self.infeasible}")
+        return "\n".join(lines)
+
+
+def presolve(m, columns, costs, cover_rows=None, max_passes=50):
+    """
+    Reduces the SPP `min c.x s.t. A x = 1 (>= 1 on cover_rows), x binary`, with column j covering rows `columns[j]`.
+    Returns a PresolveResult.
+    """
+    t0 = time.perf_counter()
+    n = len(columns)
+    cover = cover_rows or bytearray(m)
+    col_rows = [tuple(c) for c in columns]
+    row_cols = [set() for _ in range(m)]
+    for j, col in enumerate(col_rows):
+        for i in col:
+            row_cols[i].add(j)
+
+    alive_col = bytearray(b"\1") * n
+    alive_row = bytearray(b"\1") * m
+    fixed = []
+    representative = {}
+    stats = {"duplicates": 0, "conflicts": 0, "dominated": 0, "empty": 0, "rows_dropped": 0,
+             "nnz_before": sum(len(c) for c in col_rows)}
+    infeasible = None
+
+    def kill_col(j, reason):
+        alive_col[j] = 0
+        stats[reason] += 1
+        for i in col_rows[j]:
+            if alive_row[i]:
+                row_cols[i].discard(j)
+
+    def drop_row(i):
+        alive_row[i] = 0
+        row_cols[i] = set()
+        stats["rows_dropped"] += 1
+
+    def fix_col(j):
+        alive_col[j] = 0
+        fixed.append(j)
+        for i in col_rows[j]:
+            if not alive_row[i]:
+                continue
+            row_cols[i].discard(j)
+            if not cover[i]:
+                for k in list(row_cols[i]):
+                    kill_col(k, "conflicts")
+            drop_row(i)
+
+    passes = 0
+    changed = True
+    while changed and infeasible is None and passes < max_passes:
+        changed = False
+        passes += 1
+
+        # duplicate and empty columns (over the rows still in the problem)
+        best = {}
+        for j in range(n):
+            if not alive_col[j]:
+                continue
+            key = tuple(i for i in col_rows[j] if alive_row[i])
+            if not key:
+                if costs[j] < 0:
+                    fix_col(j)
+                else:
+                    kill_col(j, "empty")
+                changed = True
+                continue
+            k = best.get(key)
+            if k is None or not alive_col[k]:
+                best[key] = j
+                continue
+            keep, drop = (k, j) if costs[k] <= costs[j] else (j, k)
+            if costs[drop] < 0 and all(cover[i] for i in key):
+                continue                   # both could be selected on covering rows alone
+            kill_col(drop, "duplicates")
+            representative[drop] = keep
+            best[key] = keep
+            changed = True
+
+        # forced columns
+        for i in range(m):
+            if not alive_row[i]:
+                continue
+            if not row_cols[i]:
+                infeasible = f"row {i} cannot be covered"
+                break
+            if len(row_cols[i]) == 1:
+                fix_col(next(iter(row_cols[i])))
+                changed = True
+        if infeasible:
+            break
+
+        # row dominance: cols(r1) subset of cols(r2)
+        for r1 in range(m):
+            if not alive_row[r1]:
+                continue
+            cols1 = row_cols[r1]
+            if not cols1:
+                infeasible = f"row {r1} cannot be covered"
+                break
+            it = iter(cols1)
+            supers = {i for i in col_rows[next(it)] if alive_row[i]}
+            for k in it:
+                supers.intersection_update(col_rows[k])
+                if len(supers) <= 1:
+                    break
+            supers.discard(r1)
+            for r2 in supers:
+                if not alive_row[r2] or not alive_row[r1]:
+                    continue
+                changed = True
+                if cover[r2]:
+                    drop_row(r2)
+                    continue
+                for k in list(row_cols[r2] - cols1):
+                    kill_col(k, "dominated")
+                if cover[r1]:
+                    drop_row(r1)
+                else:
+                    drop_row(r2)
+
+    if infeasible is None:
+        for j in range(n):
+            if alive_col[j] and not any(alive_row[i] for i in col_rows[j]):
+                if costs[j] < 0:
+                    fix_col(j)
+                else:
+                    kill_col(j, "empty")
+        for i in range(m):
+            if alive_row[i] and not row_cols[i]:
+                infeasible = f"row {i} cannot be covered"
+                break
+
+    rows = [i for i in range(m) if alive_row[i]]
+    kept = [j for j in range(n) if alive_col[j]]
+    if infeasible:
+        rows, kept = [], []
+
+    # connected components of the reduced problem (union-find over rows, joined through columns)
+    parent = {i: i for i in rows}
+
+    def find(i):
+        while parent[i] != i:
+            parent[i] = parent[parent[i]]
+            i = parent[i]
+        return i
+
+    for j in kept:
+        live = [i for i in col_rows[j] if alive_row[i]]
+        root = find(live[0])
+        for i in live[1:]:
+            other = find(i)
+            if other != root:
+                parent[other] = root
+    groups = {}
+    for i in rows:
+        groups.setdefault(find(i), ([], []))[0].append(i)
+    for j in kept:
+        groups[find(next(i for i in col_rows[j] if alive_row[i]))][1].append(j)
+    components = list(groups.values())
+
+    stats["nnz_after"] = sum(sum(1 for i in col_rows[j] if alive_row[i]) for j in kept)
+    stats["passes"] = passes
+    stats["seconds"] = time.perf_counter() - t0
+    return PresolveResult(m, n, rows, kept, sorted(fixed), sum(costs[j] for j in fixed), representative,
+                          components, infeasible, stats)